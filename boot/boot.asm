@@ -3,11 +3,21 @@
 ;
 ; Memory layout:
 ; 0x7C00 - Bootloader (512 bytes)
-; 0x8000 - Kernel load address
+; 0x8000 - Kernel load address (up to 0x7FFFF, see KERNEL_MAX_SECTORS in
+;          the Makefile)
 
 BITS 16
 ORG 0x7C00
 
+; Sector count of kernel.bin, passed in by the Makefile (-DKERNEL_SECTORS=n)
+%ifndef KERNEL_SECTORS
+%error "KERNEL_SECTORS must be defined"
+%endif
+
+KERNEL_LOAD_SEG equ 0x0800 ; Kernel load address 0x8000 as a segment
+SECTOR_PARAS    equ 0x20   ; One 512-byte sector in 16-byte paragraphs
+READ_RETRIES    equ 3
+
 ; Entry point
 start:
     ; Setup segments
@@ -18,23 +28,43 @@ start:
     mov ss, ax
     mov sp, 0x7C00         ; Setup stack below bootloader
     sti                     ; Enable interrupts
+    mov [boot_drive], dl   ; BIOS passes the boot drive in DL
     
     ; Print boot message
     mov si, msg_boot
     call print_string
     
-    ; Load kernel from disk
-    ; Read sectors starting from sector 2 (after MBR)
-    mov ah, 0x02           ; BIOS read sector function
-    mov al, 32             ; Number of sectors to read (16KB kernel)
-    mov ch, 0              ; Cylinder 0
-    mov cl, 2              ; Sector 2
-    mov dh, 0              ; Head 0
-    mov dl, 0x80           ; First hard disk
-    mov bx, 0x8000         ; Load to 0x8000
-    int 0x13               ; Call BIOS
+    ; Query the drive geometry so the load can walk across tracks
+    mov ah, 0x08           ; BIOS get drive parameters
+    mov dl, [boot_drive]
+    xor di, di             ; ES:DI = 0 works around buggy BIOSes
+    int 0x13
+    jc disk_error
+    and cx, 0x3F           ; Sectors per track
+    mov [sectors_per_track], cx
+    mov dl, dh             ; Last head index
+    xor dh, dh
+    inc dx
+    mov [heads], dx
     
-    jc disk_error          ; Jump if error
+    ; Load kernel from disk, one sector at a time from LBA 1 (after the
+    ; MBR). ES steps by a sector per read so no read crosses a 64KB
+    ; segment or DMA boundary.
+    mov ax, KERNEL_LOAD_SEG
+    mov es, ax
+    mov ax, 1              ; LBA of the first kernel sector
+    mov cx, KERNEL_SECTORS
+.load_sector:
+    push cx
+    push ax
+    call read_sector
+    pop ax
+    pop cx
+    inc ax
+    mov bx, es
+    add bx, SECTOR_PARAS
+    mov es, bx
+    loop .load_sector
     
     ; Print success message
     mov si, msg_success
@@ -59,6 +89,34 @@ disk_error:
     call print_string
     jmp halt
 
+; Read one sector (AX = LBA) to ES:0000, retrying after a drive reset
+read_sector:
+    ; LBA -> CHS
+    xor dx, dx
+    div word [sectors_per_track]  ; AX = LBA / SPT, DX = LBA % SPT
+    mov cl, dl
+    inc cl                 ; Sector numbers start at 1
+    xor dx, dx
+    div word [heads]       ; AX = cylinder, DX = head
+    mov ch, al             ; Cylinder bits 0-7
+    shl ah, 6
+    or cl, ah              ; Cylinder bits 8-9 in CL bits 6-7
+    mov dh, dl             ; Head
+    mov dl, [boot_drive]
+    xor bx, bx
+    mov si, READ_RETRIES
+.retry:
+    mov ax, 0x0201         ; BIOS read sector function, 1 sector
+    int 0x13
+    jnc .done
+    xor ah, ah             ; Reset the drive and try again
+    int 0x13
+    dec si
+    jnz .retry
+    jmp disk_error
+.done:
+    ret
+
 ; Print string (SI = pointer to null-terminated string)
 print_string:
     pusha
@@ -105,6 +163,11 @@ msg_boot:     db 'Tosin RTOS Booting...', 0x0D, 0x0A, 0
 msg_success:  db 'Kernel loaded successfully!', 0x0D, 0x0A, 0
 msg_error:    db 'Disk read error!', 0x0D, 0x0A, 0
 
+; Boot drive geometry
+boot_drive:        db 0
+sectors_per_track: dw 0
+heads:             dw 0
+
 ; Global Descriptor Table
 gdt_start:
     ; Null descriptor
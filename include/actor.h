@@ -0,0 +1,56 @@
+#ifndef ACTOR_H
+#define ACTOR_H
+
+#include "types.h"
+#include "spinlock.h"
+
+struct actor;
+
+/* Message handler: runs in a pool worker, never concurrently for one actor */
+typedef void (*actor_handler_t)(struct actor *actor, void *msg);
+
+/* Actor: a mailbox plus a handler, with no task of its own
+ *
+ * An actor with mail is put on the run queue once; a pool worker then
+ * delivers up to ACTOR_BATCH messages before moving on, so the cost of a
+ * wake-up and a switch is shared by the whole batch.
+ */
+typedef struct actor {
+    const char *name;           /* Actor name */
+    actor_handler_t handler;    /* Called once per message */
+    void *state;                /* Owner data for the handler */
+    
+    void **mailbox;             /* Ring of pending messages */
+    uint32_t capacity;          /* Mailbox size */
+    uint32_t head;              /* Oldest message */
+    uint32_t count;             /* Messages pending */
+    
+    bool_t scheduled;           /* On the run queue or being run */
+    bool_t valid;               /* Not destroyed */
+    struct actor *next;         /* Next actor on the run queue */
+    spinlock_t lock;            /* Guards the mailbox and flags */
+    
+    uint32_t delivered;         /* Messages handled */
+    uint32_t dropped;           /* Sends refused with the mailbox full */
+} actor_t;
+
+/* Runtime statistics */
+typedef struct {
+    uint32_t actors;            /* Live actors */
+    uint32_t messages;          /* Messages delivered */
+    uint32_t batches;           /* Actor runs by a worker */
+    uint32_t max_batch;         /* Most messages in one run */
+} actor_stats_t;
+
+/* Actor operations */
+int32_t actor_create(actor_t **actor, const char *name, actor_handler_t handler,
+                     void *state, uint32_t capacity);
+int32_t actor_send(actor_t *actor, void *msg);
+int32_t actor_send_from_isr(actor_t *actor, void *msg);
+int32_t actor_destroy(actor_t *actor);
+void actor_get_stats(actor_stats_t *stats);
+
+/* Kernel-internal */
+void actor_init(void);
+
+#endif /* ACTOR_H */
@@ -0,0 +1,21 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include "types.h"
+
+/* Interrupt vectors served through the local APIC */
+#define APIC_TIMER_VECTOR   0x40    /* Per-CPU scheduler tick (APs) */
+#define IPI_RESCHED_VECTOR  0x41    /* Remote reschedule request */
+#define APIC_SPURIOUS_VECTOR 0xFF   /* Spurious interrupt */
+
+/* Local APIC operations */
+bool_t apic_init(void);
+void apic_init_ap(void);
+bool_t apic_present(void);
+uint32_t apic_id(void);
+void apic_eoi(void);
+void apic_send_ipi(uint32_t dest_apic_id, uint32_t vector);
+void apic_start_aps(uint32_t start_page);
+void apic_timer_start(void);
+
+#endif /* APIC_H */
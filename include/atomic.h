@@ -0,0 +1,37 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include "types.h"
+
+/* Atomic primitives (lock-prefixed, so also full memory barriers) */
+
+/* Compare-and-swap; returns the value found at *ptr */
+static inline uint32_t atomic_cmpxchg(volatile uint32_t *ptr, uint32_t old_val,
+                                      uint32_t new_val) {
+    uint32_t prev;
+    __asm__ volatile("lock cmpxchgl %2, %1"
+                     : "=a"(prev), "+m"(*ptr)
+                     : "r"(new_val), "0"(old_val)
+                     : "memory");
+    return prev;
+}
+
+/* Fetch-and-add; returns the value before the add */
+static inline uint32_t atomic_fetch_add(volatile uint32_t *ptr, uint32_t val) {
+    __asm__ volatile("lock xaddl %0, %1"
+                     : "+r"(val), "+m"(*ptr)
+                     :
+                     : "memory");
+    return val;
+}
+
+/* Swap; returns the previous value */
+static inline uint32_t atomic_xchg(volatile uint32_t *ptr, uint32_t val) {
+    __asm__ volatile("xchgl %0, %1"
+                     : "+r"(val), "+m"(*ptr)
+                     :
+                     : "memory");
+    return val;
+}
+
+#endif /* ATOMIC_H */
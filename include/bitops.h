@@ -0,0 +1,20 @@
+#ifndef BITOPS_H
+#define BITOPS_H
+
+#include "types.h"
+
+/* Index of the highest set bit (mask must be non-zero) */
+static inline uint32_t bit_highest(uint32_t mask) {
+    uint32_t bit;
+    __asm__ volatile("bsr %1, %0" : "=r"(bit) : "rm"(mask));
+    return bit;
+}
+
+/* Index of the lowest set bit (mask must be non-zero) */
+static inline uint32_t bit_lowest(uint32_t mask) {
+    uint32_t bit;
+    __asm__ volatile("bsf %1, %0" : "=r"(bit) : "rm"(mask));
+    return bit;
+}
+
+#endif /* BITOPS_H */
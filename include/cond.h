@@ -0,0 +1,29 @@
+#ifndef COND_H
+#define COND_H
+
+#include "types.h"
+#include "task.h"
+#include "waitq.h"
+#include "mutex.h"
+
+/* Condition variable
+ *
+ * Always used with one mutex. Signalling while the mutex is held moves the
+ * waiter straight onto the mutex's wait queue (wait morphing), so a
+ * broadcast does not wake tasks only to have them block on the mutex again.
+ */
+typedef struct {
+    wait_queue_t waiters;       /* Tasks waiting for a signal */
+    mutex_t *mutex;             /* Mutex bound on first wait */
+    bool_t valid;               /* Condition variable is valid */
+} cond_t;
+
+/* Condition variable operations */
+int32_t cond_init(cond_t *cond);
+int32_t cond_wait(cond_t *cond, mutex_t *mutex);
+int32_t cond_timedwait(cond_t *cond, mutex_t *mutex, uint32_t timeout_ms);
+int32_t cond_signal(cond_t *cond);
+int32_t cond_broadcast(cond_t *cond);
+int32_t cond_destroy(cond_t *cond);
+
+#endif /* COND_H */
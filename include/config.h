@@ -9,6 +9,35 @@
 /* Scheduler Configuration */
 #define TIMER_FREQ_HZ       100     /* System timer frequency (100Hz = 10ms) */
 #define TIME_SLICE_MS       10      /* Time slice per task in ms */
+#define DEFER_WORKER_ENABLED 1      /* Kernel worker task for DEFER_THREAD items */
+#define DEFER_WORKER_PRIORITY 15    /* Worker task priority (PRIORITY_CRITICAL) */
+#define EDF_PRIORITY        12      /* Level EDF tasks are scheduled at */
+#define EDF_UTIL_SCALE      1000    /* Utilization unit (1000 = one full CPU) */
+#define EDF_UTIL_MAX        1000    /* EDF utilization admitted per CPU */
+#define RESERVE_MAX_REPL    8       /* Pending replenishments per CPU reservation */
+#define RESERVE_BACKGROUND_PRIORITY 0   /* Level of throttled reservations (PRIORITY_IDLE) */
+#define CYCLIC_PRIORITY     15      /* Nominal priority of time-triggered tasks (PRIORITY_CRITICAL) */
+#define CYCLIC_LEVEL        (MAX_PRIORITY + 1)  /* Their ready-queue level, above every priority */
+#define CYCLIC_MAX_SLOTS    8       /* Tasks per minor frame */
+#define FAIR_PRIORITY       1       /* Level fair-share tasks are scheduled at (PRIORITY_LOW) */
+#define FAIR_WEIGHT_DEFAULT 1024    /* Weight of an average fair-share task */
+#define FAIR_WEIGHT_MAX     65536   /* Largest fair-share weight */
+#define FAIR_GRANULARITY    1       /* Ticks of lead before a fair task is preempted */
+#define FAIR_SLEEPER_CREDIT 2       /* Ticks of credit a waking sleeper may get */
+#define PT_POLL_MS          10      /* Protothread host re-check interval when idle */
+#define ACTOR_WORKERS       2       /* Tasks in the actor worker pool */
+#define ACTOR_WORKER_PRIORITY 5     /* Actor worker priority (PRIORITY_NORMAL) */
+#define ACTOR_BATCH         16      /* Messages delivered per actor run */
+#define WORKQ_MAX_WORKERS   8       /* Worker tasks per work queue */
+
+/* SMP Configuration */
+#define MAX_CPUS            8       /* Maximum number of CPUs */
+#define AP_STACK_SIZE       4096    /* Boot stack per application processor */
+#define AP_TRAMPOLINE_ADDR  0x7000  /* Real-mode AP start page (below 1MB) */
+
+/* Interrupt Configuration */
+#define IRQ_TRACE_ENABLED   1       /* Trace the longest interrupts-off windows */
+#define IRQ_TRACE_SITES     8       /* Call sites kept by the tracer */
 
 /* Memory Configuration */
 #define HEAP_SIZE           (1024 * 1024)  /* 1MB heap */
@@ -18,6 +47,7 @@
 #define MAX_SEMAPHORES      64      /* Maximum number of semaphores */
 #define MAX_QUEUES          32      /* Maximum number of message queues */
 #define QUEUE_SIZE          16      /* Default queue capacity */
+#define KOBJ_WAIT_MAX       8       /* Objects per kobj_wait_any() call */
 
 /* Priority Levels */
 #define PRIORITY_IDLE       0       /* Idle task priority */
@@ -26,6 +56,7 @@
 #define PRIORITY_HIGH       10      /* High priority tasks */
 #define PRIORITY_CRITICAL   15      /* Critical priority tasks */
 #define MAX_PRIORITY        15      /* Maximum priority level */
+#define SCHED_LEVELS        (MAX_PRIORITY + 2)  /* Ready-queue levels (priorities plus CYCLIC_LEVEL) */
 
 /* Shell Configuration */
 #define SHELL_BUFFER_SIZE   256     /* Shell input buffer size */
@@ -0,0 +1,71 @@
+#ifndef CYCLIC_H
+#define CYCLIC_H
+
+#include "types.h"
+#include "task.h"
+
+/* The PIT tick that drives dispatch arrives on the boot CPU */
+#define CYCLIC_CPU          0
+
+/* Entry point of a time-triggered task, called once per dispatch */
+typedef void (*cyclic_func_t)(void *arg);
+
+/* Time-triggered task
+ *
+ * Backed by a task pinned to CYCLIC_CPU at CYCLIC_LEVEL that sleeps
+ * until the schedule table releases it. Declare these statically with
+ * CYCLIC_TASK() and reference them from the frames.
+ */
+typedef struct cyclic_task {
+    const char *name;                   /* Task name */
+    cyclic_func_t func;                 /* Called once per slot */
+    void *arg;                          /* Argument for func */
+    
+    task_t *task;                       /* Backing task (created on start) */
+    volatile bool_t released;           /* Dispatched, not yet started */
+    uint32_t release_tsc;               /* TSC at the last dispatch */
+    
+    uint32_t runs;                      /* Completed slots */
+    uint32_t overruns;                  /* Still running at a frame boundary */
+    uint32_t max_latency;               /* Longest dispatch to start (cycles) */
+    uint32_t max_exec;                  /* Longest run (cycles) */
+} cyclic_task_t;
+
+/* One minor frame: the tasks run back to back, in order */
+typedef struct {
+    cyclic_task_t *slots[CYCLIC_MAX_SLOTS + 1];     /* NULL-terminated */
+} cyclic_frame_t;
+
+/* Static schedule: frame_count minor frames of minor_ticks each make up
+ * one major frame, which repeats */
+typedef struct {
+    uint32_t minor_ticks;               /* Minor frame length (ticks) */
+    uint32_t frame_count;               /* Minor frames per major frame */
+    const cyclic_frame_t *frames;       /* frame_count entries */
+} cyclic_table_t;
+
+/* Executive statistics */
+typedef struct {
+    uint32_t minor_frames;              /* Minor frames started */
+    uint32_t major_frames;              /* Major frames completed */
+    uint32_t overruns;                  /* Frames whose work was unfinished */
+    uint32_t skipped;                   /* Slots dropped by overruns */
+} cyclic_stats_t;
+
+/* Table construction */
+#define CYCLIC_TASK(name, func, arg)    { (name), (func), (arg), NULL, FALSE, 0, 0, 0, 0, 0 }
+#define CYCLIC_FRAME(...)               { { __VA_ARGS__, NULL } }
+#define CYCLIC_IDLE_FRAME               { { NULL } }
+
+/* Executive control */
+int32_t cyclic_start(const cyclic_table_t *table);
+void cyclic_stop(void);
+bool_t cyclic_is_running(void);
+const cyclic_table_t *cyclic_get_table(void);
+void cyclic_get_stats(cyclic_stats_t *stats);
+
+/* Kernel-internal */
+void cyclic_init(void);
+void cyclic_tick_from_isr(void);
+
+#endif /* CYCLIC_H */
@@ -0,0 +1,51 @@
+#ifndef DEFER_H
+#define DEFER_H
+
+#include "types.h"
+
+/* Deferred work flags */
+#define DEFER_THREAD        0x01    /* Run in the kernel worker task */
+
+/* Work queued by an interrupt handler
+ *
+ * Embedded in the kernel object it belongs to, so queuing never allocates.
+ * Items run after the EOI with interrupts enabled: on the way out of the
+ * interrupt with preemption disabled, or, with DEFER_THREAD, in the
+ * high-priority worker task as ordinary (preemptible) task code.
+ */
+typedef struct isr_defer {
+    void (*fn)(void *arg);      /* Handler */
+    void *arg;                  /* Handler argument */
+    struct isr_defer *next;     /* Next queued item */
+    const char *name;           /* Statistics name (NULL = anonymous) */
+    struct isr_defer *next_named; /* Next item with a name */
+    uint32_t flags;             /* DEFER_* flags */
+    bool_t queued;              /* Item is on a deferred list */
+    uint32_t runs;              /* Times run */
+    uint32_t last_cycles;       /* TSC cycles of the last run */
+    uint32_t max_cycles;        /* Longest run in TSC cycles */
+} isr_defer_t;
+
+/* Totals over all items */
+typedef struct {
+    uint32_t runs;              /* Items run */
+    uint32_t worker_runs;       /* Of which in the worker task */
+    uint32_t max_cycles;        /* Longest single run */
+    uint32_t anon_runs;         /* Runs of unnamed items */
+    uint32_t anon_max_cycles;   /* Longest run of an unnamed item */
+} defer_stats_t;
+
+/* Deferred work operations */
+void defer_init(void);
+void defer_item_init(isr_defer_t *item, const char *name,
+                     void (*fn)(void *arg), void *arg, uint32_t flags);
+void defer_queue_from_isr(isr_defer_t *item);
+void defer_cancel(isr_defer_t *item);
+isr_defer_t *defer_get_named(void);
+void defer_get_stats(defer_stats_t *stats);
+
+/* Kernel-internal: drain the interrupt-exit list (IF clear on return) */
+bool_t defer_pending(void);
+void defer_run(void);
+
+#endif /* DEFER_H */
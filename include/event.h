@@ -0,0 +1,35 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include "types.h"
+#include "task.h"
+#include "waitq.h"
+
+/* Event wait options */
+#define EVENT_WAIT_ANY      0x00    /* Wake when any requested bit is set */
+#define EVENT_WAIT_ALL      0x01    /* Wake when all requested bits are set */
+#define EVENT_CLEAR_ON_EXIT 0x02    /* Clear the requested bits on wake-up */
+
+/* Event flag group structure */
+typedef struct {
+    volatile uint32_t flags;    /* Current flag bits */
+    wait_queue_t waiters;       /* Tasks waiting for bits */
+    bool_t valid;               /* Group is valid */
+} event_group_t;
+
+/* Event group operations */
+int32_t event_init(event_group_t *group);
+uint32_t event_set(event_group_t *group, uint32_t bits);
+uint32_t event_clear(event_group_t *group, uint32_t bits);
+int32_t event_wait(event_group_t *group, uint32_t bits, uint32_t options,
+                   uint32_t *flags_out, uint32_t timeout_ms);
+int32_t event_trywait(event_group_t *group, uint32_t bits, uint32_t options,
+                      uint32_t *flags_out);
+uint32_t event_get(event_group_t *group);
+int32_t event_destroy(event_group_t *group);
+
+/* Kernel-internal helpers (preemption disabled) */
+bool_t event_poll(event_group_t *group, uint32_t bits, uint32_t options,
+                  uint32_t *flags_out);
+
+#endif /* EVENT_H */
@@ -0,0 +1,69 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include "types.h"
+#include "config.h"
+
+#define IRQ_FLAG_IF         0x200   /* EFLAGS interrupt-enable bit */
+
+/* Saved interrupt state */
+typedef uint32_t irq_flags_t;
+
+/* One call site in the interrupts-off trace */
+typedef struct {
+    const char *site;           /* Function that disabled interrupts */
+    uint32_t max_cycles;        /* Longest window opened there */
+    uint32_t count;             /* Windows opened there */
+} irq_trace_entry_t;
+
+/* Tracer hooks (IRQ_TRACE_ENABLED) */
+void irq_trace_begin(const char *site);
+void irq_trace_end(void);
+uint32_t irq_trace_get(irq_trace_entry_t *entries, uint32_t max);
+void irq_trace_reset(void);
+
+/* Disable interrupts, returning the previous state (nestable) */
+static inline irq_flags_t irq_save_at(const char *site) {
+    irq_flags_t flags;
+    
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags) : : "memory");
+    
+#if IRQ_TRACE_ENABLED
+    if (flags & IRQ_FLAG_IF) {
+        irq_trace_begin(site);
+    }
+#else
+    (void)site;
+#endif
+    
+    return flags;
+}
+
+/* Restore the state returned by irq_save() */
+static inline void irq_restore(irq_flags_t flags) {
+    if (flags & IRQ_FLAG_IF) {
+#if IRQ_TRACE_ENABLED
+        irq_trace_end();
+#endif
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+/* Disable interrupts unconditionally */
+static inline void irq_disable_at(const char *site) {
+    (void)irq_save_at(site);
+}
+
+/* Enable interrupts unconditionally */
+static inline void irq_enable(void) {
+#if IRQ_TRACE_ENABLED
+    irq_trace_end();
+#endif
+    __asm__ volatile("sti" : : : "memory");
+}
+
+/* Record the calling function as the site of an interrupts-off window */
+#define irq_save()          irq_save_at(__func__)
+#define irq_disable()       irq_disable_at(__func__)
+
+#endif /* IRQ_H */
@@ -0,0 +1,29 @@
+#ifndef KOBJ_H
+#define KOBJ_H
+
+#include "types.h"
+#include "semaphore.h"
+#include "queue.h"
+#include "event.h"
+
+/* Kernel object types that can be waited on together */
+typedef enum {
+    KOBJ_SEMAPHORE = 0,         /* Fires when a unit is taken */
+    KOBJ_QUEUE,                 /* Fires when a message is received */
+    KOBJ_EVENT                  /* Fires when the requested bits are set */
+} kobj_type_t;
+
+/* One entry of a multi-object wait */
+typedef struct {
+    kobj_type_t type;           /* Object type */
+    void *obj;                  /* semaphore_t, queue_t or event_group_t */
+    uint32_t bits;              /* Event: bits to wait for */
+    uint32_t options;           /* Event: EVENT_WAIT_* / EVENT_CLEAR_ON_EXIT */
+    void *msg;                  /* Out (queue): received message */
+    uint32_t flags;             /* Out (event): flags that satisfied the wait */
+} kobj_wait_t;
+
+/* Block until any object fires; returns its index, or ERROR on timeout */
+int32_t kobj_wait_any(kobj_wait_t *objs, uint32_t count, uint32_t timeout_ms);
+
+#endif /* KOBJ_H */
@@ -0,0 +1,33 @@
+#ifndef MSG_H
+#define MSG_H
+
+#include "types.h"
+#include "task.h"
+#include "waitq.h"
+
+/* Messages up to this size are copied a word at a time */
+#define MSG_SHORT_MAX       16
+
+/* Synchronous message channel
+ *
+ * A client's msg_send() blocks until the server has received the message
+ * and replied to it. When the other side is already waiting, the kernel
+ * switches straight to it instead of going through the ready queues.
+ */
+typedef struct {
+    wait_queue_t senders;       /* Clients waiting for the server */
+    task_t *receiver;           /* Server blocked in msg_receive() */
+    bool_t valid;               /* Channel is valid */
+} channel_t;
+
+/* Channel operations */
+int32_t channel_init(channel_t *chan);
+int32_t channel_destroy(channel_t *chan);
+
+/* Message passing */
+int32_t msg_send(channel_t *chan, const void *smsg, uint32_t slen,
+                 void *rmsg, uint32_t rlen);
+int32_t msg_receive(channel_t *chan, void *msg, uint32_t len, task_t **client);
+int32_t msg_reply(task_t *client, int32_t status, const void *msg, uint32_t len);
+
+#endif /* MSG_H */
@@ -0,0 +1,34 @@
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include "types.h"
+#include "task.h"
+#include "waitq.h"
+
+/* Mutex structure
+ *
+ * Owned, recursive lock with transitive priority inheritance. Waiters are
+ * always queued by priority and ownership is handed directly to the
+ * highest-priority waiter on unlock.
+ */
+typedef struct mutex {
+    task_t *owner;              /* Owning task (NULL if unlocked) */
+    uint32_t lock_count;        /* Recursion depth */
+    wait_queue_t waiters;       /* Tasks blocked on the mutex */
+    struct mutex *next_held;    /* Next mutex held by the same owner */
+    bool_t valid;               /* Mutex is valid */
+} mutex_t;
+
+/* Mutex operations */
+int32_t mutex_init(mutex_t *mutex);
+int32_t mutex_lock(mutex_t *mutex, uint32_t timeout_ms);
+int32_t mutex_trylock(mutex_t *mutex);
+int32_t mutex_unlock(mutex_t *mutex);
+int32_t mutex_destroy(mutex_t *mutex);
+task_t *mutex_get_owner(mutex_t *mutex);
+
+/* Kernel-internal helpers (preemption disabled) */
+void mutex_update_priority(task_t *task);
+void mutex_release(mutex_t *mutex);
+
+#endif /* MUTEX_H */
@@ -0,0 +1,18 @@
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+#include "types.h"
+#include "task.h"
+
+/* Notification actions */
+#define NOTIFY_SET_BITS     0       /* OR value into the notification word */
+#define NOTIFY_INCREMENT    1       /* Increment the word (value ignored) */
+#define NOTIFY_OVERWRITE    2       /* Replace the word with value */
+
+/* Direct-to-task notifications */
+int32_t task_notify(task_t *task, uint32_t value, uint32_t action);
+int32_t task_notify_from_isr(task_t *task, uint32_t value, uint32_t action);
+int32_t task_notify_wait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                         uint32_t *value_out, uint32_t timeout_ms);
+
+#endif /* NOTIFY_H */
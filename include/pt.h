@@ -0,0 +1,96 @@
+#ifndef PT_H
+#define PT_H
+
+#include "types.h"
+#include "task.h"
+#include "spinlock.h"
+#include "scheduler.h"
+#include "semaphore.h"
+#include "event.h"
+#include "queue.h"
+
+/* Protothread results */
+#define PT_WAITING          0       /* Blocked on a condition */
+#define PT_YIELDED          1       /* Gave up the host voluntarily */
+#define PT_EXITED           2       /* Finished */
+
+struct pt;
+struct pt_host;
+
+/* Protothread body: runs from its resume point to the next wait or yield */
+typedef int8_t (*pt_func_t)(struct pt *pt);
+
+/* Protothread (stackless coroutine)
+ *
+ * Resumes by jumping to the source line it stopped at, so locals of the
+ * body do not survive a wait or yield. Keep such state in a structure
+ * that embeds the pt_t; the embedded part is all the scheduler needs.
+ */
+typedef struct pt {
+    uint16_t lc;                /* Resume line (0 = start) */
+    uint8_t live;               /* Started and not exited */
+    uint8_t pad;
+    uint32_t wake_tick;         /* Tick PT_SLEEP() waits for */
+    pt_func_t func;             /* Body */
+    struct pt *next;            /* Next on the host's run list */
+} pt_t;
+
+/* Host task that runs a set of protothreads round-robin */
+typedef struct pt_host {
+    task_t *task;               /* The host task */
+    pt_t *threads;              /* Protothreads it runs */
+    pt_t *incoming;             /* Started, not yet picked up */
+    spinlock_t lock;            /* Guards incoming */
+    uint32_t live;              /* Protothreads running */
+    uint32_t passes;            /* Sweeps over the run list */
+    uint32_t resumes;           /* Protothread bodies called */
+} pt_host_t;
+
+/* Body structure */
+#define PT_BEGIN(pt)            switch ((pt)->lc) { case 0:
+#define PT_END(pt)              } (pt)->lc = 0; return PT_EXITED
+
+/* Falling into a resume label is intended */
+#define PT_FALLTHROUGH          __attribute__((fallthrough))
+
+/* Resume on a later pass once cond holds (polled on every pass) */
+#define PT_WAIT_UNTIL(pt, cond) \
+    do { (pt)->lc = __LINE__; PT_FALLTHROUGH; case __LINE__: \
+         if (!(cond)) { return PT_WAITING; } } while (0)
+#define PT_WAIT_WHILE(pt, cond) PT_WAIT_UNTIL((pt), !(cond))
+
+/* Let the other protothreads of the host run */
+#define PT_YIELD(pt) \
+    do { (pt)->lc = __LINE__; return PT_YIELDED; case __LINE__: ; } while (0)
+
+/* Finish now, or start over from PT_BEGIN on the next pass */
+#define PT_EXIT(pt)             do { (pt)->lc = 0; return PT_EXITED; } while (0)
+#define PT_RESTART(pt)          do { (pt)->lc = 0; return PT_YIELDED; } while (0)
+
+/* Wait a number of milliseconds (rounded up to ticks) */
+#define PT_SLEEP(pt, ms) \
+    do { (pt)->wake_tick = scheduler_get_tick_count() + \
+                           ((ms) * TIMER_FREQ_HZ + 999) / 1000; \
+         PT_WAIT_UNTIL((pt), (int32_t)(scheduler_get_tick_count() - \
+                                       (pt)->wake_tick) >= 0); } while (0)
+
+/* Run a child protothread to completion (child body called in place) */
+#define PT_SPAWN(pt, child, call) \
+    do { (child)->lc = 0; PT_WAIT_WHILE((pt), (call) != PT_EXITED); } while (0)
+
+/* Waits on kernel objects, without blocking the host */
+#define PT_SEM_WAIT(pt, sem)    PT_WAIT_UNTIL((pt), sem_trywait(sem) == SUCCESS)
+#define PT_EVENT_WAIT(pt, group, bits, options) \
+    PT_WAIT_UNTIL((pt), event_trywait((group), (bits), (options), NULL) == SUCCESS)
+#define PT_QUEUE_RECEIVE(pt, queue, msg) \
+    PT_WAIT_UNTIL((pt), queue_tryreceive((queue), (msg)) == SUCCESS)
+
+/* Host and protothread operations */
+int32_t pt_host_create(pt_host_t **host, const char *name, uint8_t priority);
+int32_t pt_start(pt_host_t *host, pt_t *pt, pt_func_t func);
+void pt_host_signal(pt_host_t *host);
+void pt_host_signal_from_isr(pt_host_t *host);
+
+#define pt_is_live(pt)          ((pt)->live)
+
+#endif /* PT_H */
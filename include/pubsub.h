@@ -0,0 +1,44 @@
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include "types.h"
+#include "task.h"
+#include "waitq.h"
+
+/* topic_receive() status: older messages were overwritten and skipped */
+#define TOPIC_OVERRUN       1
+
+/* Broadcast topic
+ *
+ * A single ring of message pointers shared by all subscribers. Each
+ * subscriber keeps its own read cursor; publishing never waits for slow
+ * readers, who detect the overrun on their next receive instead.
+ */
+typedef struct {
+    void **ring;                /* Message slots */
+    uint32_t capacity;          /* Number of slots (a power of two) */
+    volatile uint32_t seq;      /* Sequence number of the next publish */
+    wait_queue_t waiters;       /* Subscribers waiting for new data */
+    uint32_t subscribers;       /* Number of subscribers */
+    bool_t valid;               /* Topic is valid */
+} topic_t;
+
+/* Subscriber handle (owned by the subscribing task) */
+typedef struct {
+    topic_t *topic;             /* Subscribed topic */
+    uint32_t cursor;            /* Sequence number of the next message to read */
+    uint32_t overruns;          /* Total messages lost to overwrites */
+} subscriber_t;
+
+/* Topic operations */
+int32_t topic_create(topic_t **topic, uint32_t capacity);
+int32_t topic_publish(topic_t *topic, void *msg);
+int32_t topic_destroy(topic_t *topic);
+
+/* Subscriber operations */
+int32_t topic_subscribe(topic_t *topic, subscriber_t *sub);
+int32_t topic_unsubscribe(subscriber_t *sub);
+int32_t topic_receive(subscriber_t *sub, void **msg, uint32_t timeout_ms);
+uint32_t topic_get_pending(subscriber_t *sub);
+
+#endif /* PUBSUB_H */
@@ -4,6 +4,16 @@
 #include "types.h"
 #include "task.h"
 #include "semaphore.h"
+#include "mutex.h"
+
+/* Queue creation flags */
+#define QUEUE_PRIO_WAIT     0x01    /* Wake highest-priority sender/receiver first */
+#define QUEUE_PRIO_MSG      0x02    /* Receive highest-priority message first */
+
+/* Message priority levels for QUEUE_PRIO_MSG queues */
+#define QUEUE_MSG_LEVELS    (MAX_PRIORITY + 1)
+
+struct queue_prio;
 
 /* Message queue structure */
 typedef struct {
@@ -12,17 +22,28 @@ typedef struct {
     uint32_t count;             /* Current count */
     uint32_t head;              /* Head index */
     uint32_t tail;              /* Tail index */
-    semaphore_t mutex;          /* Mutual exclusion */
+    mutex_t mutex;              /* Mutual exclusion */
     semaphore_t not_empty;      /* Not empty semaphore */
     semaphore_t not_full;       /* Not full semaphore */
+    struct queue_prio *prio;    /* Per-priority lists (QUEUE_PRIO_MSG) */
+    uint32_t flags;             /* Creation flags */
     bool_t valid;               /* Queue is valid */
 } queue_t;
 
 /* Queue operations */
 int32_t queue_create(queue_t **queue, uint32_t capacity);
+int32_t queue_create_ex(queue_t **queue, uint32_t capacity, uint32_t flags);
 int32_t queue_send(queue_t *queue, void *msg, uint32_t timeout_ms);
+int32_t queue_send_prio(queue_t *queue, void *msg, uint8_t priority,
+                        uint32_t timeout_ms);
+int32_t queue_send_from_isr(queue_t *queue, void *msg, uint8_t priority);
 int32_t queue_receive(queue_t *queue, void **msg, uint32_t timeout_ms);
+int32_t queue_tryreceive(queue_t *queue, void **msg);
+int32_t queue_receive_from_isr(queue_t *queue, void **msg);
 int32_t queue_destroy(queue_t *queue);
 uint32_t queue_get_count(queue_t *queue);
 
+/* Kernel-internal: dequeue once a not_empty unit is held */
+int32_t queue_take(queue_t *queue, void **msg, uint32_t timeout_ms);
+
 #endif /* QUEUE_H */
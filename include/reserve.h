@@ -0,0 +1,52 @@
+#ifndef RESERVE_H
+#define RESERVE_H
+
+#include "types.h"
+#include "task.h"
+#include "spinlock.h"
+
+/* CPU reservation (sporadic server)
+ *
+ * Member tasks share a budget of ticks per period. Every tick a member
+ * runs is charged; when the budget is used up the reservation is
+ * throttled and its members drop to RESERVE_BACKGROUND_PRIORITY, where they
+ * only soak up otherwise idle time. Consumed budget comes back one period
+ * after the run that used it started, so over any window of one period
+ * the members get at most budget ticks at their own priority.
+ */
+typedef struct reserve {
+    const char *name;                   /* Reservation name */
+    uint32_t budget;                    /* Ticks per period */
+    uint32_t period;                    /* Replenishment period (ticks) */
+    volatile uint32_t remaining;        /* Budget left right now */
+    volatile bool_t throttled;          /* Budget exhausted, members in background */
+    uint32_t last_charge;               /* Tick of the last charge */
+    
+    uint32_t repl_time[RESERVE_MAX_REPL];   /* Pending replenishments, oldest first */
+    uint32_t repl_amount[RESERVE_MAX_REPL];
+    uint32_t repl_head;                 /* Index of the oldest */
+    uint32_t repl_count;                /* Number pending */
+    
+    uint32_t consumed;                  /* Ticks charged in total */
+    uint32_t throttles;                 /* Times the budget ran out */
+    uint32_t replenishments;            /* Replenishments applied */
+    
+    task_t *members;                    /* Attached tasks (next_reserved) */
+    struct reserve *next;               /* Next reservation in the global list */
+    spinlock_t lock;                    /* Guards the budget state */
+} reserve_t;
+
+/* Reservation operations */
+int32_t reserve_create(reserve_t **res, const char *name, uint32_t budget_ms,
+                       uint32_t period_ms);
+int32_t reserve_delete(reserve_t *res);
+int32_t reserve_attach(reserve_t *res, task_t *task);
+int32_t reserve_detach(task_t *task);
+reserve_t *reserve_get_list(void);
+
+/* Kernel-internal */
+void reserve_init(void);
+void reserve_charge_from_isr(task_t *task, uint32_t now);
+void reserve_tick_from_isr(uint32_t now);
+
+#endif /* RESERVE_H */
@@ -4,24 +4,46 @@
 #include "types.h"
 #include "task.h"
 
+struct cpu;
+
 /* Scheduler initialization and control */
 void scheduler_init(void);
 void scheduler_start(void);
+void scheduler_start_ap(void);
+void scheduler_task_start(void);
+void scheduler_set_idle(struct cpu *cpu, task_t *task);
 void scheduler_tick(void);
+void scheduler_local_tick(void);
 void schedule(void);
+void scheduler_handoff(task_t *next);
+void scheduler_handoff_block(task_t *next);
+task_t *scheduler_get_current(void);
 
 /* Task queue management */
 void scheduler_add_task(task_t *task);
 void scheduler_remove_task(task_t *task);
 void scheduler_block_task(task_t *task);
 void scheduler_unblock_task(task_t *task);
+void scheduler_unblock_task_from_isr(task_t *task);
+void scheduler_set_priority(task_t *task, uint8_t priority);
+void scheduler_requeue(task_t *task);
+int32_t scheduler_suspend_task(task_t *task);
+int32_t scheduler_resume_task(task_t *task);
+int32_t scheduler_admit_edf(task_t *task, uint32_t util);
 
 /* Preemption control */
 void scheduler_disable_preemption(void);
+bool_t scheduler_try_disable_preemption(void);
 void scheduler_enable_preemption(void);
 
+/* Interrupt context */
+void scheduler_irq_enter(void);
+void scheduler_irq_exit(void);
+bool_t scheduler_in_isr(void);
+
 /* Statistics */
 uint32_t scheduler_get_tick_count(void);
+uint32_t scheduler_us_since_tick(uint32_t tick);
 uint32_t scheduler_get_task_count(void);
 
 #endif /* SCHEDULER_H */
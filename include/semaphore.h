@@ -3,20 +3,39 @@
 
 #include "types.h"
 #include "task.h"
+#include "waitq.h"
+#include "defer.h"
+
+/* Semaphore creation flags */
+#define SEM_PRIO_WAIT       0x01    /* Wake highest-priority waiter first */
 
 /* Semaphore structure */
 typedef struct {
-    uint32_t count;         /* Current count */
+    volatile uint32_t count; /* Current count (updated atomically) */
     uint32_t max_count;     /* Maximum count */
-    task_t *wait_queue;     /* Queue of waiting tasks */
+    wait_queue_t waiters;   /* Queue of waiting tasks */
+    isr_defer_t isr_wake;   /* Wake-up deferred by sem_post_from_isr() */
     bool_t valid;           /* Semaphore is valid */
 } semaphore_t;
 
+/* Semaphore path statistics */
+typedef struct {
+    uint32_t fast_waits;    /* sem_wait() satisfied by the atomic fast path */
+    uint32_t slow_waits;    /* sem_wait() that entered the wait-queue path */
+    uint32_t fast_posts;    /* sem_post() with nobody waiting */
+    uint32_t slow_posts;    /* sem_post() that had to wake a waiter */
+} sem_stats_t;
+
 /* Semaphore operations */
 int32_t sem_init(semaphore_t *sem, uint32_t initial_count, uint32_t max_count);
+int32_t sem_init_ex(semaphore_t *sem, uint32_t initial_count, uint32_t max_count,
+                    uint32_t flags);
 int32_t sem_wait(semaphore_t *sem, uint32_t timeout_ms);
+int32_t sem_trywait(semaphore_t *sem);
 int32_t sem_post(semaphore_t *sem);
+int32_t sem_post_from_isr(semaphore_t *sem);
 int32_t sem_destroy(semaphore_t *sem);
 int32_t sem_get_count(semaphore_t *sem);
+void sem_get_stats(sem_stats_t *stats);
 
 #endif /* SEMAPHORE_H */
@@ -0,0 +1,52 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include "types.h"
+#include "config.h"
+#include "task.h"
+#include "spinlock.h"
+
+/* Per-CPU scheduler state
+ *
+ * Each CPU owns a set of priority ready queues with a bitmap of non-empty
+ * levels, guarded by its own lock. A CPU with nothing to run steals from
+ * the busiest other CPU before falling back to its idle task.
+ */
+typedef struct cpu {
+    uint32_t id;                        /* Logical CPU number (0 = BSP) */
+    uint32_t apic_id;                   /* Local APIC ID */
+    volatile bool_t online;             /* Running the scheduler */
+    
+    task_t *current;                    /* Task running on this CPU */
+    task_t *idle;                       /* Run when nothing else is ready */
+    task_t *prev_task;                  /* Task being switched out */
+    
+    task_t *ready[SCHED_LEVELS];        /* Ready queue per level */
+    uint32_t ready_bitmap;              /* Bit n set if ready[n] is non-empty */
+    uint32_t nr_ready;                  /* Tasks on the ready queues */
+    uint32_t edf_util;                  /* Admitted EDF utilization (EDF_UTIL_SCALE) */
+    uint32_t min_vruntime;              /* Fair-share timeline floor (only grows) */
+    spinlock_t lock;                    /* Guards queues, current, prev_task */
+    
+    volatile uint32_t irq_nesting;      /* Interrupt handler depth */
+    volatile bool_t need_resched;       /* Reschedule at the next chance */
+    volatile bool_t preempt_off;        /* This CPU holds the kernel lock */
+    
+    uint32_t ticks;                     /* Scheduler ticks taken */
+    uint32_t switches;                  /* Context switches */
+    uint32_t steals;                    /* Tasks pulled from other CPUs */
+    uint32_t ipis;                      /* Reschedule IPIs received */
+} cpu_t;
+
+/* Per-CPU access */
+cpu_t *cpu_self(void);
+cpu_t *cpu_get(uint32_t id);
+uint32_t smp_cpu_count(void);
+
+/* Bring-up */
+void smp_init(void);
+void smp_ap_main(uint32_t id);
+void smp_send_resched(cpu_t *cpu);
+void smp_resched_interrupt(void);
+
+#endif /* SMP_H */
@@ -0,0 +1,54 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+#include "atomic.h"
+#include "irq.h"
+
+/* Busy-wait lock for data shared between CPUs */
+typedef struct {
+    volatile uint32_t locked;   /* 1 while held */
+} spinlock_t;
+
+/* Initialize a lock */
+static inline void spin_init(spinlock_t *lock) {
+    lock->locked = 0;
+}
+
+/* Acquire a lock (spinning on a plain read keeps the cache line shared) */
+static inline void spin_lock(spinlock_t *lock) {
+    while (atomic_xchg(&lock->locked, 1)) {
+        while (lock->locked) {
+            __asm__ volatile("pause");
+        }
+    }
+}
+
+/* Acquire a lock only if it is free */
+static inline bool_t spin_trylock(spinlock_t *lock) {
+    return atomic_xchg(&lock->locked, 1) == 0;
+}
+
+/* Release a lock */
+static inline void spin_unlock(spinlock_t *lock) {
+    __asm__ volatile("" : : : "memory");
+    lock->locked = 0;
+}
+
+/* Disable interrupts on this CPU, then acquire */
+static inline irq_flags_t spin_lock_irqsave_at(spinlock_t *lock, const char *site) {
+    irq_flags_t flags = irq_save_at(site);
+    
+    spin_lock(lock);
+    return flags;
+}
+
+/* Release, then restore this CPU's interrupt state */
+static inline void spin_unlock_irqrestore(spinlock_t *lock, irq_flags_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#define spin_lock_irqsave(lock)     spin_lock_irqsave_at((lock), __func__)
+
+#endif /* SPINLOCK_H */
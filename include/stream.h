@@ -0,0 +1,37 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "types.h"
+#include "task.h"
+#include "waitq.h"
+
+/* Byte stream buffer
+ *
+ * A byte ring copied in contiguous spans. A blocked reader is only woken
+ * once at least min(trigger, its max_len) bytes are buffered, so a parser
+ * waiting for a frame header does not wake on every byte.
+ */
+typedef struct {
+    uint8_t *buffer;            /* Byte ring */
+    uint32_t size;              /* Ring size in bytes */
+    uint32_t head;              /* Read index */
+    uint32_t tail;              /* Write index */
+    uint32_t count;             /* Bytes buffered */
+    uint32_t trigger;           /* Bytes needed to wake a reader */
+    bool_t waking;              /* A reader was picked in this wake pass */
+    wait_queue_t readers;       /* Tasks waiting for data */
+    wait_queue_t writers;       /* Tasks waiting for space */
+    bool_t valid;               /* Stream is valid */
+} stream_t;
+
+/* Stream operations */
+int32_t stream_create(stream_t **stream, uint32_t size, uint32_t trigger);
+int32_t stream_write(stream_t *stream, const void *data, uint32_t len,
+                     uint32_t timeout_ms);
+int32_t stream_read(stream_t *stream, void *buf, uint32_t max_len,
+                    uint32_t timeout_ms);
+int32_t stream_set_trigger(stream_t *stream, uint32_t trigger);
+uint32_t stream_get_count(stream_t *stream);
+int32_t stream_destroy(stream_t *stream);
+
+#endif /* STREAM_H */
@@ -33,12 +33,57 @@ typedef struct {
     uint32_t gs;
 } cpu_context_t;
 
+/* Scheduling classes */
+#define SCHED_FIXED         0       /* Fixed priority, round-robin per level */
+#define SCHED_EDF           1       /* Earliest deadline first at EDF_PRIORITY */
+#define SCHED_FAIR          2       /* Weighted fair share at FAIR_PRIORITY */
+#define SCHED_CYCLIC        3       /* Time-triggered, alone at CYCLIC_LEVEL */
+
+struct wait_queue;
+struct mutex;
+struct task_struct;
+
+/* Wait queue entry; every task embeds one, multi-object waits use more */
+typedef struct wait_node {
+    struct task_struct *task;           /* Waiting task */
+    struct wait_node *next;             /* Next node in wait queue */
+    struct wait_node *prev;             /* Previous node in wait queue */
+    struct wait_queue *queue;           /* Wait queue node is linked on */
+    uint8_t level;                      /* Wait queue level node is on */
+    uint32_t mask;                      /* What the task is waiting for */
+    uint32_t options;                   /* How the wait should be satisfied */
+} wait_node_t;
+
+/* Per-job statistics of a periodic task (microseconds) */
+typedef struct {
+    uint32_t jobs;                      /* Jobs started */
+    uint32_t jitter_min;                /* Release to job start */
+    uint32_t jitter_max;
+    uint32_t jitter_avg;                /* Running mean (no sum to wrap) */
+    uint32_t exec_min;                  /* Job start to completion */
+    uint32_t exec_max;
+    uint32_t exec_avg;
+    uint32_t completed;                 /* Jobs completed */
+    uint32_t overruns;                  /* Jobs that ran into the next release */
+} periodic_stats_t;
+
+/* Snapshot of a periodic task, for statistics */
+typedef struct {
+    char name[TASK_NAME_LEN];           /* Task name */
+    uint32_t period;                    /* Release interval (ticks) */
+    uint8_t sched_class;                /* SCHED_FIXED or SCHED_EDF */
+    uint32_t deadline_misses;           /* EDF: jobs past their deadline */
+    periodic_stats_t stats;             /* Release/execution statistics */
+} periodic_info_t;
+
 /* Task Control Block (TCB) */
 typedef struct task_struct {
     uint32_t task_id;                   /* Unique task ID */
     char name[TASK_NAME_LEN];           /* Task name */
     task_state_t state;                 /* Current state */
     uint8_t priority;                   /* Task priority (0-15) */
+    uint8_t base_priority;              /* Priority without inheritance */
+    uint8_t level;                      /* Ready-queue level it was queued at */
     uint32_t time_slice;                /* Remaining time slice */
     
     cpu_context_t context;              /* Saved CPU context */
@@ -50,19 +95,84 @@ typedef struct task_struct {
     
     uint32_t wake_time;                 /* Wake time for sleeping tasks */
     void *wait_obj;                     /* Object task is waiting on */
+    wait_node_t wait_node;              /* Entry for single-object waits */
+    wait_node_t *wait_multi;            /* Entries for multi-object waits */
+    uint32_t wait_multi_count;          /* Number of multi-object entries */
+    wait_node_t *wait_fired;            /* Entry the waker claimed */
+    bool_t wait_pending;                /* Queued and not yet claimed */
+    int32_t wait_result;                /* Result handed over by the waker */
+    uint32_t wait_value;                /* Value handed over by the waker */
+    
+    volatile uint32_t notify_value;     /* Direct-to-task notification word */
+    volatile bool_t notify_pending;     /* Notification not yet consumed */
+    volatile bool_t notify_waiting;     /* Blocked in task_notify_wait() */
+    
+    void *ipc_request;                  /* Pending synchronous message */
+    struct task_struct *ipc_server;     /* Server that took the request and owes a reply */
+    
+    struct mutex *held_mutexes;         /* Mutexes owned by this task */
+    struct mutex *wait_mutex;           /* Mutex task is blocked on */
+    
+    uint32_t cpu;                       /* CPU the task runs or is queued on */
+    uint32_t affinity;                  /* Bitmask of CPUs it may run on */
+    volatile bool_t on_cpu;             /* Context not yet saved after switch-out */
+    bool_t suspended;                   /* Held off the ready queues by task_suspend() */
+    int32_t exit_code;                  /* Code passed to task_exit() */
+    
+    uint32_t period;                    /* Release interval (ticks, 0 = not periodic) */
+    uint32_t release;                   /* Release tick of the current job */
+    uint32_t job_start;                 /* TSC when the current job started */
+    periodic_stats_t periodic;          /* Release/execution statistics */
+    struct task_struct *next_periodic;  /* Next task in the periodic list */
+    
+    uint8_t sched_class;                /* SCHED_FIXED, SCHED_EDF, SCHED_FAIR or SCHED_CYCLIC */
+    uint32_t edf_budget;                /* EDF: declared execution time (ticks) */
+    uint32_t edf_deadline;              /* EDF: relative deadline (ticks) */
+    uint32_t edf_util;                  /* EDF: admitted density (EDF_UTIL_SCALE) */
+    uint32_t abs_deadline;              /* EDF: deadline tick of the current job */
+    bool_t deadline_missed;             /* Current job already counted as late */
+    uint32_t deadline_misses;           /* Jobs that ran past their deadline */
+    
+    uint32_t fair_weight;               /* Fair: share relative to other fair tasks */
+    uint32_t vruntime;                  /* Fair: weighted run time (CPU-relative while blocked) */
+    uint32_t fair_sleep;                /* Fair: tick it blocked at */
+    uint32_t fair_ticks;                /* Fair: ticks run in total */
+    struct task_struct *next_fair;      /* Next task in the fair-share list */
+    
+    struct reserve *reserve;            /* CPU reservation charged, or NULL */
+    struct task_struct *next_reserved;  /* Next member of the same reservation */
 } task_t;
 
+#define TASK_AFFINITY_ALL   0xFFFFFFFF  /* May run on any CPU */
+
 /* Task function type */
 typedef void (*task_func_t)(void *arg);
 
 /* Task management functions */
 int32_t task_create(task_t **task, const char *name, task_func_t func, 
                     void *arg, uint8_t priority, uint32_t stack_size);
+int32_t task_create_edf(task_t **task, const char *name, task_func_t func,
+                        void *arg, uint32_t period_ms, uint32_t budget_ms,
+                        uint32_t deadline_ms, uint32_t stack_size);
+void task_edf_wait_next(void);
+int32_t task_create_periodic(task_t **task, const char *name, task_func_t func,
+                             void *arg, uint8_t priority, uint32_t period_ms,
+                             uint32_t stack_size);
+int32_t task_wait_next_period(void);
+int32_t task_get_periodic_info(uint32_t index, periodic_info_t *info);
+void task_reset_periodic_stats(task_t *task);
 void task_destroy(task_t *task);
 void task_yield(void);
 void task_sleep(uint32_t ms);
-void task_exit(void);
+void task_exit(int32_t code);
+int32_t task_join(task_t *task, int32_t *code, uint32_t timeout_ms);
+int32_t task_suspend(task_t *task);
+int32_t task_resume(task_t *task);
 task_t *task_get_current(void);
 int32_t task_set_priority(task_t *task, uint8_t priority);
+int32_t task_create_fair(task_t **task, const char *name, task_func_t func,
+                         void *arg, uint32_t weight, uint32_t stack_size);
+int32_t task_set_weight(task_t *task, uint32_t weight);
+task_t *task_get_fair(void);
 
 #endif /* TASK_H */
@@ -0,0 +1,46 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+
+/* Timer modes */
+#define TIMER_ONE_SHOT      0       /* Fire once, then stop */
+#define TIMER_AUTO_RELOAD   1       /* Fire every period until stopped */
+
+struct timer;
+
+/* Timer callback (runs in the kernel worker task; must not block) */
+typedef void (*timer_func_t)(struct timer *timer, void *arg);
+
+/* Software timer
+ *
+ * Active timers sit on one list sorted by expiry tick, so the tick only
+ * compares against the head and expiry costs O(expired).
+ */
+typedef struct timer {
+    timer_func_t func;          /* Callback */
+    void *arg;                  /* Callback argument */
+    uint32_t period;            /* Period in ticks */
+    uint32_t expiry;            /* Tick of next expiry */
+    uint32_t mode;              /* TIMER_ONE_SHOT or TIMER_AUTO_RELOAD */
+    struct timer *next;         /* Next active timer (later expiry) */
+    struct timer *prev;         /* Previous active timer */
+    bool_t active;              /* Timer is on the active list */
+    bool_t running;             /* Callback in progress (freed after it if deleted) */
+    bool_t valid;               /* Timer is valid */
+} timer_t;
+
+/* Timer operations */
+int32_t timer_create(timer_t **timer, timer_func_t func, void *arg,
+                     uint32_t period_ms, uint32_t mode);
+int32_t timer_start(timer_t *timer);
+int32_t timer_stop(timer_t *timer);
+int32_t timer_change_period(timer_t *timer, uint32_t period_ms);
+int32_t timer_delete(timer_t *timer);
+bool_t timer_is_active(timer_t *timer);
+
+/* Kernel-internal */
+void timer_init(void);
+void timer_tick_from_isr(uint32_t now);
+
+#endif /* TIMER_H */
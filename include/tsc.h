@@ -0,0 +1,26 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include "types.h"
+
+/* Read the time-stamp counter */
+static inline uint64_t tsc_read(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Low half of the time-stamp counter, for short intervals */
+static inline uint32_t tsc_read32(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* Calibration and conversion */
+void tsc_init(void);
+uint32_t tsc_get_mhz(void);
+uint32_t tsc_to_us(uint32_t cycles);
+void tsc_delay_us(uint32_t us);
+
+#endif /* TSC_H */
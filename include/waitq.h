@@ -0,0 +1,50 @@
+#ifndef WAITQ_H
+#define WAITQ_H
+
+#include "types.h"
+#include "task.h"
+
+/* Wait queue ordering policies */
+#define WAITQ_FIFO          0       /* First come, first served */
+#define WAITQ_PRIORITY      1       /* Highest priority first, FIFO within a level */
+
+/* Wait queue structure
+ *
+ * One FIFO ring of wait nodes per priority level plus a bitmap of non-empty
+ * levels, so the highest-priority waiter is found with a single bit scan.
+ * FIFO queues only use level 0. A task waiting on several objects at once
+ * has one node on each queue; the first waker to claim it wins and the
+ * other nodes are skipped as stale.
+ */
+typedef struct wait_queue {
+    wait_node_t *level[MAX_PRIORITY + 1];   /* Per-level waiter rings */
+    uint32_t bitmap;                        /* Bit n set if level[n] is non-empty */
+    uint32_t count;                         /* Number of queued nodes */
+    uint8_t policy;                         /* WAITQ_FIFO or WAITQ_PRIORITY */
+} wait_queue_t;
+
+/* Wake filter: return TRUE to wake the waiter */
+typedef bool_t (*waitq_match_t)(wait_node_t *node, void *arg);
+
+/* Wait queue operations */
+void waitq_init(wait_queue_t *wq, uint8_t policy);
+void waitq_add(wait_queue_t *wq, wait_node_t *node);
+void waitq_del(wait_queue_t *wq, wait_node_t *node);
+void waitq_enqueue(wait_queue_t *wq, task_t *task);
+task_t *waitq_dequeue(wait_queue_t *wq);
+task_t *waitq_peek(wait_queue_t *wq);
+bool_t waitq_remove(wait_queue_t *wq, task_t *task);
+void waitq_requeue(task_t *task);
+void waitq_cancel(task_t *task);
+
+/* Blocking helpers (caller has preemption disabled) */
+int32_t waitq_block(wait_queue_t *wq, void *obj, uint32_t timeout_ms);
+int32_t waitq_sleep(wait_queue_t *wq, void *obj, uint32_t timeout_ms);
+void waitq_park(uint32_t timeout_ms);
+task_t *waitq_wake_one(wait_queue_t *wq);
+uint32_t waitq_wake_all(wait_queue_t *wq, int32_t result);
+uint32_t waitq_wake_if(wait_queue_t *wq, waitq_match_t match, void *arg);
+
+#define waitq_empty(wq)     ((wq)->count == 0)
+
+#endif /* WAITQ_H */
@@ -0,0 +1,66 @@
+#ifndef WORKQ_H
+#define WORKQ_H
+
+#include "types.h"
+#include "task.h"
+#include "spinlock.h"
+#include "semaphore.h"
+
+/* Job states */
+#define WORK_IDLE           0       /* Never submitted */
+#define WORK_QUEUED         1       /* Waiting for a worker */
+#define WORK_RUNNING        2       /* Being run */
+#define WORK_DONE           3       /* Finished */
+
+/* Job function (runs in a pool worker task; may block) */
+typedef void (*work_func_t)(void *arg);
+
+/* Job, allocated by the submitter and reusable once done
+ *
+ * The job is its own completion handle: work_wait() blocks until a worker
+ * marks it done, and any number of tasks may wait.
+ */
+typedef struct work {
+    work_func_t func;           /* Job function */
+    void *arg;                  /* Argument for func */
+    volatile uint32_t state;    /* WORK_IDLE .. WORK_DONE */
+    uint32_t submit_tsc;        /* TSC at submission */
+    struct work *next;          /* Next job in the queue */
+} work_t;
+
+/* Work queue statistics (times in microseconds) */
+typedef struct {
+    uint32_t submitted;         /* Jobs accepted */
+    uint32_t completed;         /* Jobs finished */
+    uint32_t batches;           /* workq_submit_batch() calls */
+    uint32_t queued;            /* Jobs waiting now */
+    uint32_t latency_max;       /* Submission to start */
+    uint32_t latency_total;
+    uint32_t exec_max;          /* Start to finish */
+    uint32_t exec_total;
+} workq_stats_t;
+
+/* Work queue: a FIFO of jobs served by a fixed set of worker tasks */
+typedef struct workq {
+    const char *name;           /* Queue name (also the workers' name) */
+    work_t *head;               /* Oldest queued job */
+    work_t *tail;               /* Newest queued job */
+    spinlock_t lock;            /* Guards the job list and statistics */
+    semaphore_t pending;        /* One unit per queued job */
+    uint32_t workers;           /* Worker tasks */
+    workq_stats_t stats;        /* Counters */
+    struct workq *next;         /* Next queue in the global list */
+} workq_t;
+
+/* Work queue operations */
+int32_t workq_create(workq_t **wq, const char *name, uint32_t workers,
+                     uint8_t priority);
+int32_t work_init(work_t *work, work_func_t func, void *arg);
+int32_t workq_submit(workq_t *wq, work_t *work);
+int32_t workq_submit_batch(workq_t *wq, work_t **works, uint32_t count);
+int32_t work_wait(work_t *work, uint32_t timeout_ms);
+bool_t work_is_done(work_t *work);
+void workq_get_stats(workq_t *wq, workq_stats_t *stats);
+workq_t *workq_get_list(void);
+
+#endif /* WORKQ_H */
@@ -0,0 +1,139 @@
+#include "../include/apic.h"
+#include "../include/tsc.h"
+#include "../include/config.h"
+
+/* Local APIC register offsets */
+#define LAPIC_ID            0x020
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_CUR     0x390
+#define LAPIC_TIMER_DIV     0x3E0
+
+/* ICR fields */
+#define ICR_DELIVERY_INIT   0x00000500
+#define ICR_DELIVERY_SIPI   0x00000600
+#define ICR_PENDING         0x00001000
+#define ICR_LEVEL_ASSERT    0x00004000
+#define ICR_ALL_BUT_SELF    0x000C0000
+
+#define LVT_MASKED          0x00010000
+#define LVT_PERIODIC        0x00020000
+#define SVR_ENABLE          0x00000100
+#define TIMER_DIV_16        0x3
+
+#define MSR_APIC_BASE       0x1B
+#define APIC_BASE_ENABLE    0x800
+
+static volatile uint32_t *lapic = NULL;
+static uint32_t timer_count = 0;        /* LAPIC timer counts per tick */
+
+/* Read a local APIC register */
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+/* Write a local APIC register */
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+    (void)lapic[LAPIC_ID / 4];          /* Flush the posted write */
+}
+
+/* Wait for the last IPI to be accepted */
+static void lapic_wait_icr(void) {
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING) {
+        __asm__ volatile("pause");
+    }
+}
+
+/* Software-enable this CPU's local APIC */
+static void lapic_enable(void) {
+    lapic_write(LAPIC_SVR, SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+}
+
+/* Detect and enable the BSP's local APIC, calibrating its timer
+ *
+ * Returns FALSE on CPUs without an APIC; the kernel then stays on one CPU.
+ */
+bool_t apic_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t lo, hi;
+    uint32_t elapsed;
+    
+    eax = 1;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    if (!(edx & (1U << 9))) {
+        return FALSE;
+    }
+    
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(MSR_APIC_BASE));
+    lo |= APIC_BASE_ENABLE;
+    __asm__ volatile("wrmsr" : : "a"(lo), "d"(hi), "c"(MSR_APIC_BASE));
+    
+    lapic = (volatile uint32_t *)(lo & 0xFFFFF000);
+    lapic_enable();
+    
+    /* Count timer decrements over 10ms to find the per-tick count */
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    tsc_delay_us(10000);
+    elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    
+    timer_count = (elapsed * 100) / TIMER_FREQ_HZ;
+    
+    return TRUE;
+}
+
+/* Enable an application processor's local APIC */
+void apic_init_ap(void) {
+    lapic_enable();
+}
+
+/* Check whether the local APIC is in use */
+bool_t apic_present(void) {
+    return lapic != NULL;
+}
+
+/* Get the executing CPU's APIC ID */
+uint32_t apic_id(void) {
+    return lapic ? lapic_read(LAPIC_ID) >> 24 : 0;
+}
+
+/* Acknowledge an interrupt delivered by the local APIC */
+void apic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* Send a fixed interrupt to another CPU */
+void apic_send_ipi(uint32_t dest_apic_id, uint32_t vector) {
+    lapic_wait_icr();
+    lapic_write(LAPIC_ICR_HIGH, dest_apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, vector);
+}
+
+/* Wake every other CPU with INIT-SIPI-SIPI at start_page * 4KB */
+void apic_start_aps(uint32_t start_page) {
+    lapic_wait_icr();
+    lapic_write(LAPIC_ICR_LOW, ICR_ALL_BUT_SELF | ICR_LEVEL_ASSERT | ICR_DELIVERY_INIT);
+    tsc_delay_us(10000);
+    
+    lapic_wait_icr();
+    lapic_write(LAPIC_ICR_LOW, ICR_ALL_BUT_SELF | ICR_DELIVERY_SIPI | (start_page & 0xFF));
+    tsc_delay_us(200);
+    
+    lapic_wait_icr();
+    lapic_write(LAPIC_ICR_LOW, ICR_ALL_BUT_SELF | ICR_DELIVERY_SIPI | (start_page & 0xFF));
+    lapic_wait_icr();
+}
+
+/* Start this CPU's periodic scheduler tick */
+void apic_timer_start(void) {
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_PERIODIC | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, timer_count);
+}
@@ -0,0 +1,263 @@
+#include "../include/cyclic.h"
+#include "../include/scheduler.h"
+#include "../include/spinlock.h"
+#include "../include/tsc.h"
+#include "../include/config.h"
+
+/* Executive state (cyclic_lock)
+ *
+ * Only the timer interrupt and the pinned cyclic tasks, all on CYCLIC_CPU,
+ * touch it while running; the lock covers start/stop from other CPUs.
+ */
+static const cyclic_table_t *cyclic_table = NULL;
+static volatile bool_t cyclic_running = FALSE;
+static uint32_t cyclic_frame;           /* Current minor frame */
+static uint32_t cyclic_frame_tick;      /* Ticks into the current minor frame */
+static uint32_t cyclic_slot;            /* Next slot of the frame to dispatch */
+static cyclic_task_t *cyclic_active;    /* Dispatched and not finished */
+static cyclic_stats_t cyclic_stats;
+static spinlock_t cyclic_lock;
+
+/* Count the slots of a frame */
+static uint32_t cyclic_frame_slots(const cyclic_frame_t *frame) {
+    uint32_t n = 0;
+    
+    while (n < CYCLIC_MAX_SLOTS && frame->slots[n]) {
+        n++;
+    }
+    
+    return n;
+}
+
+/* Release the next slot of the current frame (cyclic_lock held, IF clear) */
+static void cyclic_dispatch_next(void) {
+    const cyclic_frame_t *frame = &cyclic_table->frames[cyclic_frame];
+    cyclic_task_t *ct;
+    
+    if (cyclic_slot >= cyclic_frame_slots(frame)) {
+        return;
+    }
+    
+    ct = frame->slots[cyclic_slot++];
+    ct->released = TRUE;
+    ct->release_tsc = tsc_read32();
+    cyclic_active = ct;
+    
+    /* A task dispatched twice in a row is still running and just loops */
+    scheduler_unblock_task_from_isr(ct->task);
+}
+
+/* Body of every time-triggered task */
+static void cyclic_task_entry(void *arg) {
+    cyclic_task_t *ct = (cyclic_task_t *)arg;
+    uint32_t start;
+    uint32_t cycles;
+    irq_flags_t flags;
+    
+    while (1) {
+        /* IF stays clear from the check to the block, so a dispatch from
+         * the timer interrupt on this CPU cannot slip in between */
+        flags = spin_lock_irqsave(&cyclic_lock);
+        while (!ct->released) {
+            spin_unlock(&cyclic_lock);
+            scheduler_block_task(ct->task);
+            schedule();
+            spin_lock(&cyclic_lock);
+        }
+        ct->released = FALSE;
+        start = tsc_read32();
+        cycles = start - ct->release_tsc;
+        if (cycles > ct->max_latency) {
+            ct->max_latency = cycles;
+        }
+        spin_unlock_irqrestore(&cyclic_lock, flags);
+        
+        ct->func(ct->arg);
+        
+        flags = spin_lock_irqsave(&cyclic_lock);
+        cycles = tsc_read32() - start;
+        if (cycles > ct->max_exec) {
+            ct->max_exec = cycles;
+        }
+        ct->runs++;
+        
+        /* Hand the CPU straight to the next slot of the frame */
+        if (cyclic_active == ct) {
+            cyclic_active = NULL;
+            if (cyclic_running) {
+                cyclic_dispatch_next();
+            }
+        }
+        spin_unlock_irqrestore(&cyclic_lock, flags);
+    }
+}
+
+/* Check a table before it is used */
+static bool_t cyclic_table_valid(const cyclic_table_t *table) {
+    uint32_t i;
+    
+    if (!table || !table->frames || table->minor_ticks == 0 ||
+        table->frame_count == 0) {
+        return FALSE;
+    }
+    
+    /* Slots past CYCLIC_MAX_SLOTS would be ignored silently */
+    for (i = 0; i < table->frame_count; i++) {
+        if (table->frames[i].slots[CYCLIC_MAX_SLOTS]) {
+            return FALSE;
+        }
+    }
+    
+    return TRUE;
+}
+
+/* Create the backing task of a cyclic task and wait until it sleeps */
+static int32_t cyclic_task_setup(cyclic_task_t *ct) {
+    if (ct->task) {
+        return SUCCESS;
+    }
+    
+    if (!ct->name || !ct->func ||
+        task_create(&ct->task, ct->name, cyclic_task_entry, ct,
+                    CYCLIC_PRIORITY, 0) != SUCCESS) {
+        return ERROR;
+    }
+    
+    /* It blocks before it can be dispatched, and wakes only on our CPU,
+     * above every priority */
+    ct->task->affinity = (1U << CYCLIC_CPU);
+    ct->task->sched_class = SCHED_CYCLIC;
+    scheduler_requeue(ct->task);
+    while (ct->task->state != TASK_BLOCKED) {
+        task_yield();
+    }
+    
+    return SUCCESS;
+}
+
+/* Set up the executive */
+void cyclic_init(void) {
+    cyclic_table = NULL;
+    cyclic_running = FALSE;
+    cyclic_active = NULL;
+    spin_init(&cyclic_lock);
+}
+
+/* Advance the schedule one tick (timer interrupt on CYCLIC_CPU)
+ *
+ * At a minor frame boundary, work still left from the previous frame is
+ * an overrun: its remaining slots are dropped and the new frame starts
+ * as soon as the late task finishes.
+ */
+void cyclic_tick_from_isr(void) {
+    const cyclic_frame_t *frame;
+    uint32_t left;
+    
+    if (!cyclic_running) {
+        return;
+    }
+    
+    spin_lock(&cyclic_lock);
+    
+    if (!cyclic_running || ++cyclic_frame_tick < cyclic_table->minor_ticks) {
+        spin_unlock(&cyclic_lock);
+        return;
+    }
+    cyclic_frame_tick = 0;
+    
+    frame = &cyclic_table->frames[cyclic_frame];
+    left = cyclic_frame_slots(frame) - cyclic_slot;
+    if (cyclic_active || left > 0) {
+        cyclic_stats.overruns++;
+        cyclic_stats.skipped += left;
+        if (cyclic_active) {
+            cyclic_active->overruns++;
+        }
+    }
+    
+    /* The wrap into the very first frame completes nothing */
+    if (++cyclic_frame == cyclic_table->frame_count) {
+        cyclic_frame = 0;
+        if (cyclic_stats.minor_frames > 0) {
+            cyclic_stats.major_frames++;
+        }
+    }
+    cyclic_stats.minor_frames++;
+    cyclic_slot = 0;
+    
+    if (!cyclic_active) {
+        cyclic_dispatch_next();
+    }
+    
+    spin_unlock(&cyclic_lock);
+}
+
+/* Start time-triggered dispatch from a static table
+ *
+ * Creates the backing tasks on first use; the first minor frame begins
+ * at the next tick.
+ */
+int32_t cyclic_start(const cyclic_table_t *table) {
+    uint32_t i;
+    uint32_t j;
+    irq_flags_t flags;
+    
+    if (cyclic_running || !cyclic_table_valid(table)) {
+        return ERROR;
+    }
+    
+    for (i = 0; i < table->frame_count; i++) {
+        for (j = 0; table->frames[i].slots[j]; j++) {
+            if (cyclic_task_setup(table->frames[i].slots[j]) != SUCCESS) {
+                return ERROR;
+            }
+        }
+    }
+    
+    flags = spin_lock_irqsave(&cyclic_lock);
+    cyclic_table = table;
+    cyclic_frame = table->frame_count - 1;
+    cyclic_frame_tick = table->minor_ticks - 1;
+    cyclic_slot = cyclic_frame_slots(&table->frames[cyclic_frame]);
+    cyclic_active = NULL;
+    cyclic_stats.minor_frames = 0;
+    cyclic_stats.major_frames = 0;
+    cyclic_stats.overruns = 0;
+    cyclic_stats.skipped = 0;
+    cyclic_running = TRUE;
+    spin_unlock_irqrestore(&cyclic_lock, flags);
+    
+    return SUCCESS;
+}
+
+/* Stop dispatching; a task already released finishes its slot */
+void cyclic_stop(void) {
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&cyclic_lock);
+    cyclic_running = FALSE;
+    spin_unlock_irqrestore(&cyclic_lock, flags);
+}
+
+/* Check whether the executive is dispatching */
+bool_t cyclic_is_running(void) {
+    return cyclic_running;
+}
+
+/* Get the table last started (NULL if none) */
+const cyclic_table_t *cyclic_get_table(void) {
+    return cyclic_table;
+}
+
+/* Copy the executive statistics */
+void cyclic_get_stats(cyclic_stats_t *stats) {
+    irq_flags_t flags;
+    
+    if (!stats) {
+        return;
+    }
+    
+    flags = spin_lock_irqsave(&cyclic_lock);
+    *stats = cyclic_stats;
+    spin_unlock_irqrestore(&cyclic_lock, flags);
+}
@@ -0,0 +1,266 @@
+#include "../include/defer.h"
+#include "../include/scheduler.h"
+#include "../include/task.h"
+#include "../include/tsc.h"
+#include "../include/config.h"
+#include "../include/irq.h"
+#include "../include/smp.h"
+#include "../include/spinlock.h"
+
+/* Pending items; every list is only touched under defer_lock. Items run at
+ * interrupt exit on the CPU that queued them. */
+static isr_defer_t *exit_head[MAX_CPUS];    /* Run at interrupt exit */
+static isr_defer_t *exit_tail[MAX_CPUS];
+static isr_defer_t *thread_head = NULL;     /* Run by the worker task */
+static isr_defer_t *thread_tail = NULL;
+static spinlock_t defer_lock;
+
+static isr_defer_t *named_items = NULL;
+static defer_stats_t defer_stats;
+static task_t *worker = NULL;
+
+/* Append an item to a list */
+static void defer_append(isr_defer_t **head, isr_defer_t **tail, isr_defer_t *item) {
+    item->next = NULL;
+    
+    if (*tail) {
+        (*tail)->next = item;
+    } else {
+        *head = item;
+    }
+    *tail = item;
+}
+
+/* Take the first item off a list */
+static isr_defer_t *defer_pop(isr_defer_t **head, isr_defer_t **tail) {
+    isr_defer_t *item = *head;
+    
+    if (item) {
+        *head = item->next;
+        if (!*head) {
+            *tail = NULL;
+        }
+        item->next = NULL;
+        item->queued = FALSE;
+    }
+    
+    return item;
+}
+
+/* Unlink an item from a list if present */
+static void defer_unlink(isr_defer_t **head, isr_defer_t **tail, isr_defer_t *item) {
+    isr_defer_t **link = head;
+    
+    *tail = NULL;
+    while (*link) {
+        if (*link == item) {
+            *link = item->next;
+            item->next = NULL;
+        } else {
+            *tail = *link;
+            link = &(*link)->next;
+        }
+    }
+}
+
+/* Run one item with interrupts enabled and account its run time */
+static void defer_call(isr_defer_t *item, bool_t in_worker) {
+    uint32_t start;
+    uint32_t cycles;
+    irq_flags_t flags;
+    
+    irq_enable();
+    
+    start = tsc_read32();
+    item->fn(item->arg);
+    cycles = tsc_read32() - start;
+    
+    /* Worker items run without the kernel lock, so the totals shared with
+     * interrupt-exit items on other CPUs need one of their own */
+    flags = spin_lock_irqsave(&defer_lock);
+    
+    item->runs++;
+    item->last_cycles = cycles;
+    if (cycles > item->max_cycles) {
+        item->max_cycles = cycles;
+    }
+    
+    defer_stats.runs++;
+    if (in_worker) {
+        defer_stats.worker_runs++;
+    }
+    if (cycles > defer_stats.max_cycles) {
+        defer_stats.max_cycles = cycles;
+    }
+    if (!item->name) {
+        defer_stats.anon_runs++;
+        if (cycles > defer_stats.anon_max_cycles) {
+            defer_stats.anon_max_cycles = cycles;
+        }
+    }
+    
+    spin_unlock_irqrestore(&defer_lock, flags);
+}
+
+/* Worker task: runs DEFER_THREAD items at high priority
+ *
+ * Items run as ordinary task code with preemption enabled, so they may
+ * call the non-blocking kernel API (sem_post(), event_set(), ...) and
+ * take whatever locks they need themselves.
+ */
+static void defer_worker(void *arg) {
+    task_t *self = task_get_current();
+    isr_defer_t *item;
+    
+    while (1) {
+        irq_disable();
+        spin_lock(&defer_lock);
+        item = defer_pop(&thread_head, &thread_tail);
+        
+        if (!item) {
+            /* Nothing queued: sleep until defer_queue_from_isr() wakes us.
+             * Blocking under the lock means no wake-up can slip between. */
+            self->wake_time = 0;
+            scheduler_block_task(self);
+            spin_unlock(&defer_lock);
+            schedule();
+            continue;
+        }
+        spin_unlock(&defer_lock);
+        
+        defer_call(item, TRUE);
+    }
+}
+
+/* Start the worker task (after the scheduler is initialized) */
+void defer_init(void) {
+#if DEFER_WORKER_ENABLED
+    if (task_create(&worker, "kworker", defer_worker, NULL,
+                    DEFER_WORKER_PRIORITY, 0) != SUCCESS) {
+        worker = NULL;
+    }
+#endif
+}
+
+/* Initialize a deferred work item */
+void defer_item_init(isr_defer_t *item, const char *name,
+                     void (*fn)(void *arg), void *arg, uint32_t flags) {
+    irq_flags_t irq_flags;
+    
+    item->fn = fn;
+    item->arg = arg;
+    item->next = NULL;
+    item->name = name;
+    item->next_named = NULL;
+    item->flags = flags;
+    item->queued = FALSE;
+    item->runs = 0;
+    item->last_cycles = 0;
+    item->max_cycles = 0;
+    
+    if (name) {
+        irq_flags = spin_lock_irqsave(&defer_lock);
+        item->next_named = named_items;
+        named_items = item;
+        spin_unlock_irqrestore(&defer_lock, irq_flags);
+    }
+}
+
+/* Queue an item from an interrupt handler (IF clear)
+ *
+ * An item that is already queued is not added twice; its handler picks up
+ * every event posted before it runs.
+ */
+void defer_queue_from_isr(isr_defer_t *item) {
+    uint32_t cpu;
+    bool_t wake = FALSE;
+    irq_flags_t flags;
+    
+    if (!item) {
+        return;
+    }
+    
+    flags = spin_lock_irqsave(&defer_lock);
+    
+    if (item->queued) {
+        spin_unlock_irqrestore(&defer_lock, flags);
+        return;
+    }
+    
+    item->queued = TRUE;
+    
+    if ((item->flags & DEFER_THREAD) && worker) {
+        defer_append(&thread_head, &thread_tail, item);
+        wake = TRUE;
+    } else {
+        cpu = cpu_self()->id;
+        defer_append(&exit_head[cpu], &exit_tail[cpu], item);
+    }
+    
+    spin_unlock_irqrestore(&defer_lock, flags);
+    
+    if (wake) {
+        scheduler_unblock_task_from_isr(worker);
+    }
+}
+
+/* Drop a queued item (object being destroyed) */
+void defer_cancel(isr_defer_t *item) {
+    irq_flags_t flags;
+    uint32_t i;
+    
+    if (!item) {
+        return;
+    }
+    
+    flags = spin_lock_irqsave(&defer_lock);
+    
+    if (item->queued) {
+        for (i = 0; i < MAX_CPUS; i++) {
+            defer_unlink(&exit_head[i], &exit_tail[i], item);
+        }
+        defer_unlink(&thread_head, &thread_tail, item);
+        item->queued = FALSE;
+    }
+    
+    spin_unlock_irqrestore(&defer_lock, flags);
+}
+
+/* Check for items waiting for interrupt exit on this CPU */
+bool_t defer_pending(void) {
+    return exit_head[cpu_self()->id] != NULL;
+}
+
+/* Run every interrupt-exit item of this CPU, including ones queued meanwhile
+ *
+ * Called by the scheduler with preemption disabled; items run with
+ * interrupts enabled and IF is clear on return.
+ */
+void defer_run(void) {
+    isr_defer_t *item;
+    uint32_t cpu;
+    
+    for (;;) {
+        irq_disable();
+        cpu = cpu_self()->id;
+        spin_lock(&defer_lock);
+        item = defer_pop(&exit_head[cpu], &exit_tail[cpu]);
+        spin_unlock(&defer_lock);
+        if (!item) {
+            break;
+        }
+        defer_call(item, FALSE);
+    }
+}
+
+/* Get the first named item (follow next_named for the rest) */
+isr_defer_t *defer_get_named(void) {
+    return named_items;
+}
+
+/* Get run-time totals */
+void defer_get_stats(defer_stats_t *stats) {
+    if (stats) {
+        *stats = defer_stats;
+    }
+}
@@ -4,11 +4,39 @@
 BITS 32
 EXTERN kmain
 EXTERN scheduler_tick_handler
+EXTERN scheduler_irq_enter
+EXTERN scheduler_irq_exit
+EXTERN scheduler_local_tick
+EXTERN apic_eoi
+EXTERN smp_resched_interrupt
+EXTERN smp_ap_main
+EXTERN ap_stacks
+EXTERN ap_stack_size
+EXTERN ap_cpu_limit
 
 GLOBAL _start
 GLOBAL context_switch
 GLOBAL enable_interrupts
 GLOBAL disable_interrupts
+GLOBAL load_idt
+GLOBAL ap_trampoline_start
+GLOBAL ap_trampoline_end
+
+; Must match AP_TRAMPOLINE_ADDR in config.h
+AP_TRAMPOLINE_ADDR equ 0x7000
+
+; Address of a trampoline label once copied to AP_TRAMPOLINE_ADDR
+%define TRAMPOLINE(label) ((label) - ap_trampoline_start + AP_TRAMPOLINE_ADDR)
+
+; Install an interrupt gate: SET_GATE vector, handler
+%macro SET_GATE 2
+    mov eax, %2
+    mov [idt_entries + %1*8], ax
+    shr eax, 16
+    mov [idt_entries + %1*8 + 6], ax
+    mov word [idt_entries + %1*8 + 2], 0x08  ; Code segment
+    mov byte [idt_entries + %1*8 + 5], 0x8E  ; Present, Ring 0, Interrupt gate
+%endmacro
 
 section .text
 
@@ -122,16 +150,19 @@ idt_ptr:
     dw 256*8 - 1           ; IDT limit
     dd idt_entries         ; IDT base
 
+ap_next_id:
+    dd 1                   ; Logical number of the next AP to arrive
+
 section .text
 GLOBAL setup_idt
 setup_idt:
     ; Setup timer interrupt (IRQ0)
-    mov eax, timer_interrupt_handler
-    mov [idt_entries + 32*8], ax
-    shr eax, 16
-    mov [idt_entries + 32*8 + 6], ax
-    mov word [idt_entries + 32*8 + 2], 0x08  ; Code segment
-    mov byte [idt_entries + 32*8 + 5], 0x8E  ; Present, Ring 0, Interrupt gate
+    SET_GATE 32, timer_interrupt_handler
+    
+    ; Local APIC timer, reschedule IPI and spurious vectors (see apic.h)
+    SET_GATE 0x40, apic_timer_handler
+    SET_GATE 0x41, resched_ipi_handler
+    SET_GATE 0xFF, spurious_handler
     
     ; Load IDT
     lidt [idt_ptr]
@@ -185,12 +216,16 @@ timer_interrupt_handler:
     mov es, ax
     
     ; Call C handler
+    call scheduler_irq_enter
     call scheduler_tick_handler
     
     ; Send EOI to PIC
     mov al, 0x20
     out 0x20, al
     
+    ; Deferred wake-ups and any reschedule, once per interrupt
+    call scheduler_irq_exit
+    
     pop gs
     pop fs
     pop es
@@ -198,4 +233,122 @@ timer_interrupt_handler:
     popa
     iret
 
+; Local APIC timer handler (scheduler tick on the APs)
+apic_timer_handler:
+    pusha
+    push ds
+    push es
+    push fs
+    push gs
+    
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    
+    call scheduler_irq_enter
+    call scheduler_local_tick
+    call apic_eoi
+    call scheduler_irq_exit
+    
+    pop gs
+    pop fs
+    pop es
+    pop ds
+    popa
+    iret
+
+; Reschedule IPI handler; the reschedule itself happens on irq exit
+resched_ipi_handler:
+    pusha
+    push ds
+    push es
+    push fs
+    push gs
+    
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    
+    call scheduler_irq_enter
+    call smp_resched_interrupt
+    call scheduler_irq_exit
+    
+    pop gs
+    pop fs
+    pop es
+    pop ds
+    popa
+    iret
+
+; Spurious local APIC interrupt (no EOI)
+spurious_handler:
+    iret
+
+; Load the shared IDT on an application processor
+load_idt:
+    lidt [idt_ptr]
+    ret
+
+; AP startup trampoline
+; Copied to AP_TRAMPOLINE_ADDR and entered in real mode by the startup IPI.
+; Switches to protected mode, takes a CPU number and a boot stack, then
+; calls smp_ap_main(id). Code here must not use relative calls into the
+; kernel, since it does not run at its link address.
+BITS 16
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    
+    lgdt [TRAMPOLINE(ap_gdt_descriptor)]
+    
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+    
+    jmp dword 0x08:TRAMPOLINE(ap_protected_mode)
+
+BITS 32
+ap_protected_mode:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    
+    ; Claim a CPU number
+    mov eax, 1
+    lock xadd [ap_next_id], eax
+    cmp eax, [ap_cpu_limit]
+    jae .park
+    
+    ; Stack top for AP n is the end of slot n - 1
+    mov ebx, eax
+    imul eax, [ap_stack_size]
+    add eax, ap_stacks
+    mov esp, eax
+    
+    push ebx
+    mov eax, smp_ap_main
+    call eax
+
+.park:
+    cli
+    hlt
+    jmp .park
+
+align 8
+ap_gdt:
+    dq 0                       ; Null descriptor
+    dq 0x00CF9A000000FFFF      ; Code segment (same as the boot GDT)
+    dq 0x00CF92000000FFFF      ; Data segment
+
+ap_gdt_descriptor:
+    dw 3*8 - 1
+    dd TRAMPOLINE(ap_gdt)
+
+ap_trampoline_end:
+
 section .bss
@@ -0,0 +1,122 @@
+#include "../include/irq.h"
+#include "../include/tsc.h"
+#include "../include/smp.h"
+#include "../include/spinlock.h"
+
+/* Open window of one CPU (only touched by that CPU, interrupts disabled) */
+typedef struct {
+    bool_t active;
+    uint32_t start;
+    const char *site;
+} irq_window_t;
+
+static irq_window_t windows[MAX_CPUS];
+
+/* Worst windows, one entry per call site, shared by all CPUs */
+static irq_trace_entry_t trace_table[IRQ_TRACE_SITES];
+static spinlock_t trace_lock;
+
+/* Note where and when interrupts went off */
+void irq_trace_begin(const char *site) {
+    irq_window_t *win = &windows[cpu_self()->id];
+    
+    win->active = TRUE;
+    win->site = site;
+    win->start = tsc_read32();
+}
+
+/* Close the open window and charge it to its call site */
+void irq_trace_end(void) {
+    irq_window_t *win = &windows[cpu_self()->id];
+    const char *trace_site = win->site;
+    uint32_t cycles;
+    uint32_t i;
+    irq_trace_entry_t *slot = NULL;
+    
+    /* Interrupts were disabled by hardware or a task switch, not by us */
+    if (!win->active) {
+        return;
+    }
+    
+    cycles = tsc_read32() - win->start;
+    win->active = FALSE;
+    
+    spin_lock(&trace_lock);
+    
+    for (i = 0; i < IRQ_TRACE_SITES; i++) {
+        if (trace_table[i].site == trace_site) {
+            slot = &trace_table[i];
+            break;
+        }
+        
+        /* Free slot, or else the mildest offender */
+        if (!slot || slot->max_cycles > trace_table[i].max_cycles) {
+            slot = &trace_table[i];
+        }
+    }
+    
+    if (slot->site != trace_site) {
+        if (slot->site && slot->max_cycles >= cycles) {
+            spin_unlock(&trace_lock);
+            return;
+        }
+        slot->site = trace_site;
+        slot->max_cycles = 0;
+        slot->count = 0;
+    }
+    
+    slot->count++;
+    if (cycles > slot->max_cycles) {
+        slot->max_cycles = cycles;
+    }
+    
+    spin_unlock(&trace_lock);
+}
+
+/* Copy out the recorded sites, worst first; returns the number copied */
+uint32_t irq_trace_get(irq_trace_entry_t *entries, uint32_t max) {
+    irq_flags_t flags;
+    uint32_t count = 0;
+    uint32_t i;
+    uint32_t j;
+    
+    flags = spin_lock_irqsave(&trace_lock);
+    
+    for (i = 0; i < IRQ_TRACE_SITES; i++) {
+        if (!trace_table[i].site) {
+            continue;
+        }
+        
+        /* Insertion sort by longest window */
+        j = (count < max) ? count++ : max;
+        while (j > 0 && entries[j - 1].max_cycles < trace_table[i].max_cycles) {
+            if (j < max) {
+                entries[j] = entries[j - 1];
+            }
+            j--;
+        }
+        if (j < max) {
+            entries[j] = trace_table[i];
+        }
+    }
+    
+    spin_unlock_irqrestore(&trace_lock, flags);
+    
+    return count;
+}
+
+/* Forget all recorded windows */
+void irq_trace_reset(void) {
+    irq_flags_t flags;
+    uint32_t i;
+    
+    flags = spin_lock_irqsave(&trace_lock);
+    
+    for (i = 0; i < IRQ_TRACE_SITES; i++) {
+        trace_table[i].site = NULL;
+        trace_table[i].max_cycles = 0;
+        trace_table[i].count = 0;
+    }
+    
+    spin_unlock_irqrestore(&trace_lock, flags);
+}
@@ -3,6 +3,13 @@
 #include "../include/memory.h"
 #include "../include/task.h"
 #include "../include/scheduler.h"
+#include "../include/defer.h"
+#include "../include/tsc.h"
+#include "../include/timer.h"
+#include "../include/reserve.h"
+#include "../include/cyclic.h"
+#include "../include/actor.h"
+#include "../include/smp.h"
 #include "../include/shell.h"
 #include "../include/io.h"
 
@@ -38,18 +45,32 @@ void kmain(void) {
     mem_init(kernel_heap, HEAP_SIZE);
     printf("  Heap size: %u bytes\n", HEAP_SIZE);
     
+    /* Calibrate the time-stamp counter */
+    tsc_init();
+    printf("  TSC: %u MHz\n", tsc_get_mhz());
+    
     /* Initialize scheduler */
     printf("Initializing scheduler...\n");
     scheduler_init();
     printf("  Timer frequency: %u Hz\n", TIMER_FREQ_HZ);
     printf("  Time slice: %u ms\n", TIME_SLICE_MS);
     
+    /* Start deferred work, timers, CPU reservations and the cyclic executive */
+    defer_init();
+    timer_init();
+    reserve_init();
+    cyclic_init();
+    
+    /* Start the actor worker pool */
+    actor_init();
+    
     /* Create idle task */
     printf("Creating idle task...\n");
     if (task_create(&idle, "idle", idle_task, NULL, PRIORITY_IDLE, 0) != SUCCESS) {
         printf("ERROR: Failed to create idle task!\n");
         while(1);
     }
+    scheduler_set_idle(cpu_get(0), idle);
     
     /* Create shell task */
     printf("Creating shell task...\n");
@@ -58,6 +79,11 @@ void kmain(void) {
         while(1);
     }
     
+    /* Bring up the other CPUs; they start scheduling with us */
+    printf("Starting application processors...\n");
+    smp_init();
+    printf("  CPUs: %u\n", smp_cpu_count());
+    
     printf("\nInitialization complete!\n");
     printf("Starting scheduler...\n\n");
     
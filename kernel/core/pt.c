@@ -0,0 +1,145 @@
+#include "../include/pt.h"
+#include "../include/notify.h"
+#include "../include/memory.h"
+#include "../include/config.h"
+
+/* Move newly started protothreads onto the run list (host task) */
+static void pt_host_collect(pt_host_t *host) {
+    pt_t *pt;
+    pt_t *last;
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&host->lock);
+    pt = host->incoming;
+    host->incoming = NULL;
+    spin_unlock_irqrestore(&host->lock, flags);
+    
+    if (!pt) {
+        return;
+    }
+    
+    for (last = pt; last->next; last = last->next) {
+        host->live++;
+    }
+    host->live++;
+    
+    last->next = host->threads;
+    host->threads = pt;
+}
+
+/* Run every live protothread once; returns TRUE if any yielded */
+static bool_t pt_host_pass(pt_host_t *host) {
+    pt_t **link = &host->threads;
+    pt_t *pt;
+    bool_t yielded = FALSE;
+    
+    while ((pt = *link) != NULL) {
+        host->resumes++;
+        
+        switch (pt->func(pt)) {
+        case PT_EXITED:
+            *link = pt->next;
+            pt->next = NULL;
+            pt->live = FALSE;
+            host->live--;
+            continue;
+        case PT_YIELDED:
+            yielded = TRUE;
+            break;
+        default:
+            break;
+        }
+        
+        link = &pt->next;
+    }
+    
+    host->passes++;
+    
+    return yielded;
+}
+
+/* Host task: sweep the protothreads, sleeping while all of them wait
+ *
+ * Wait conditions are polled, so with nothing runnable the host sleeps
+ * until signalled or for PT_POLL_MS, then checks them all again.
+ */
+static void pt_host_task(void *arg) {
+    pt_host_t *host = (pt_host_t *)arg;
+    
+    while (1) {
+        pt_host_collect(host);
+        
+        if (pt_host_pass(host)) {
+            task_yield();
+        } else {
+            task_notify_wait(0, 0xFFFFFFFF, NULL, PT_POLL_MS);
+        }
+    }
+}
+
+/* Create a host task for protothreads */
+int32_t pt_host_create(pt_host_t **host, const char *name, uint8_t priority) {
+    pt_host_t *h;
+    
+    if (!host || !name) {
+        return ERROR;
+    }
+    
+    h = (pt_host_t *)kmalloc(sizeof(pt_host_t));
+    if (!h) {
+        return ERROR;
+    }
+    
+    h->threads = NULL;
+    h->incoming = NULL;
+    spin_init(&h->lock);
+    h->live = 0;
+    h->passes = 0;
+    h->resumes = 0;
+    
+    if (task_create(&h->task, name, pt_host_task, h, priority, 0) != SUCCESS) {
+        kfree(h);
+        return ERROR;
+    }
+    
+    *host = h;
+    
+    return SUCCESS;
+}
+
+/* Start a protothread on a host (any context); it runs from PT_BEGIN */
+int32_t pt_start(pt_host_t *host, pt_t *pt, pt_func_t func) {
+    irq_flags_t flags;
+    
+    if (!host || !pt || !func || pt->live) {
+        return ERROR;
+    }
+    
+    pt->lc = 0;
+    pt->live = TRUE;
+    pt->wake_tick = 0;
+    pt->func = func;
+    
+    flags = spin_lock_irqsave(&host->lock);
+    pt->next = host->incoming;
+    host->incoming = pt;
+    spin_unlock_irqrestore(&host->lock, flags);
+    
+    pt_host_signal(host);
+    
+    return SUCCESS;
+}
+
+/* Wake a host so it re-checks its waiting protothreads now */
+void pt_host_signal(pt_host_t *host) {
+    if (host) {
+        task_notify(host->task, 1, NOTIFY_SET_BITS);
+    }
+}
+
+/* Wake a host from an interrupt handler */
+void pt_host_signal_from_isr(pt_host_t *host) {
+    if (host) {
+        task_notify_from_isr(host->task, 1, NOTIFY_SET_BITS);
+    }
+}
@@ -0,0 +1,296 @@
+#include "../include/reserve.h"
+#include "../include/scheduler.h"
+#include "../include/memory.h"
+#include "../include/config.h"
+
+/* All reservations (reserve_list_lock; also guards the member lists)
+ *
+ * Lock order: reserve_list_lock, then a CPU lock (inside the scheduler).
+ * A reservation's own lock is a leaf.
+ */
+static reserve_t *reserve_head = NULL;
+static spinlock_t reserve_list_lock;
+
+/* Tick comparison that survives counter wrap-around */
+#define TICK_REACHED(now, t)    ((int32_t)((now) - (t)) >= 0)
+
+/* Convert a duration to ticks (at least one) */
+static uint32_t reserve_ms_to_ticks(uint32_t ms) {
+    uint32_t ticks = (ms * TIMER_FREQ_HZ) / 1000;
+    
+    return ticks ? ticks : 1;
+}
+
+/* Record one tick of consumption for replenishment (reservation locked)
+ *
+ * Back-to-back ticks form one run, replenished together one period after
+ * the run started. With every slot taken the newest run absorbs the tick
+ * and moves to the later time, which only ever delays budget.
+ */
+static void reserve_post(reserve_t *res, uint32_t now) {
+    uint32_t tail;
+    
+    if (res->repl_count > 0) {
+        tail = (res->repl_head + res->repl_count - 1) % RESERVE_MAX_REPL;
+        
+        if (now - res->last_charge <= 1) {
+            res->repl_amount[tail]++;
+            res->last_charge = now;
+            return;
+        }
+        
+        if (res->repl_count == RESERVE_MAX_REPL) {
+            res->repl_amount[tail]++;
+            res->repl_time[tail] = now - 1 + res->period;
+            res->last_charge = now;
+            return;
+        }
+    }
+    
+    /* The tick being charged started one tick ago */
+    tail = (res->repl_head + res->repl_count) % RESERVE_MAX_REPL;
+    res->repl_time[tail] = now - 1 + res->period;
+    res->repl_amount[tail] = 1;
+    res->repl_count++;
+    res->last_charge = now;
+}
+
+/* Move every member to the queue level matching the throttle state */
+static void reserve_requeue_members(reserve_t *res) {
+    task_t *task;
+    
+    for (task = res->members; task; task = task->next_reserved) {
+        scheduler_requeue(task);
+    }
+}
+
+/* Set up the reservation list */
+void reserve_init(void) {
+    reserve_head = NULL;
+    spin_init(&reserve_list_lock);
+}
+
+/* Charge the tick just elapsed to the running task's reservation
+ * (interrupt context)
+ *
+ * The pointer is read again under reserve_list_lock, so a reservation
+ * being deleted on another CPU is either charged in full or not at all.
+ */
+void reserve_charge_from_isr(task_t *task, uint32_t now) {
+    reserve_t *res;
+    bool_t exhausted = FALSE;
+    
+    spin_lock(&reserve_list_lock);
+    
+    res = task->reserve;
+    if (!res) {
+        spin_unlock(&reserve_list_lock);
+        return;
+    }
+    
+    spin_lock(&res->lock);
+    
+    /* Background time is free */
+    if (!res->throttled && res->remaining > 0) {
+        res->remaining--;
+        res->consumed++;
+        reserve_post(res, now);
+        
+        if (res->remaining == 0) {
+            res->throttled = TRUE;
+            res->throttles++;
+            exhausted = TRUE;
+        }
+    }
+    
+    spin_unlock(&res->lock);
+    
+    if (exhausted) {
+        reserve_requeue_members(res);
+    }
+    
+    spin_unlock(&reserve_list_lock);
+}
+
+/* Apply due replenishments and release throttled reservations
+ * (timer interrupt) */
+void reserve_tick_from_isr(uint32_t now) {
+    reserve_t *res;
+    bool_t release;
+    
+    spin_lock(&reserve_list_lock);
+    
+    for (res = reserve_head; res; res = res->next) {
+        spin_lock(&res->lock);
+        
+        while (res->repl_count > 0 &&
+               TICK_REACHED(now, res->repl_time[res->repl_head])) {
+            res->remaining += res->repl_amount[res->repl_head];
+            res->repl_head = (res->repl_head + 1) % RESERVE_MAX_REPL;
+            res->repl_count--;
+            res->replenishments++;
+        }
+        if (res->remaining > res->budget) {
+            res->remaining = res->budget;
+        }
+        
+        release = res->throttled && res->remaining > 0;
+        if (release) {
+            res->throttled = FALSE;
+        }
+        
+        spin_unlock(&res->lock);
+        
+        if (release) {
+            reserve_requeue_members(res);
+        }
+    }
+    
+    spin_unlock(&reserve_list_lock);
+}
+
+/* Create a reservation with a full budget */
+int32_t reserve_create(reserve_t **res, const char *name, uint32_t budget_ms,
+                       uint32_t period_ms) {
+    reserve_t *r;
+    uint32_t budget;
+    uint32_t period;
+    irq_flags_t flags;
+    
+    if (!res || !name || budget_ms == 0 || period_ms == 0) {
+        return ERROR;
+    }
+    
+    budget = reserve_ms_to_ticks(budget_ms);
+    period = reserve_ms_to_ticks(period_ms);
+    if (budget > period) {
+        return ERROR;
+    }
+    
+    r = (reserve_t *)kmalloc(sizeof(reserve_t));
+    if (!r) {
+        return ERROR;
+    }
+    
+    r->name = name;
+    r->budget = budget;
+    r->period = period;
+    r->remaining = budget;
+    r->throttled = FALSE;
+    r->last_charge = 0;
+    r->repl_head = 0;
+    r->repl_count = 0;
+    r->consumed = 0;
+    r->throttles = 0;
+    r->replenishments = 0;
+    r->members = NULL;
+    spin_init(&r->lock);
+    
+    flags = spin_lock_irqsave(&reserve_list_lock);
+    r->next = reserve_head;
+    reserve_head = r;
+    spin_unlock_irqrestore(&reserve_list_lock, flags);
+    
+    *res = r;
+    
+    return SUCCESS;
+}
+
+/* Detach every member and free a reservation */
+int32_t reserve_delete(reserve_t *res) {
+    reserve_t **link;
+    task_t *task;
+    irq_flags_t flags;
+    
+    if (!res) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&reserve_list_lock);
+    
+    for (link = &reserve_head; *link; link = &(*link)->next) {
+        if (*link == res) {
+            *link = res->next;
+            break;
+        }
+    }
+    
+    while ((task = res->members) != NULL) {
+        res->members = task->next_reserved;
+        task->reserve = NULL;
+        task->next_reserved = NULL;
+        scheduler_requeue(task);
+    }
+    
+    spin_unlock_irqrestore(&reserve_list_lock, flags);
+    
+    kfree(res);
+    
+    return SUCCESS;
+}
+
+/* Charge a task's execution to a reservation
+ *
+ * EDF tasks already have a budget checked at admission and cannot join.
+ */
+int32_t reserve_attach(reserve_t *res, task_t *task) {
+    irq_flags_t flags;
+    
+    if (!res || !task || task->sched_class != SCHED_FIXED) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&reserve_list_lock);
+    
+    if (task->reserve) {
+        spin_unlock_irqrestore(&reserve_list_lock, flags);
+        return ERROR;
+    }
+    
+    task->reserve = res;
+    task->next_reserved = res->members;
+    res->members = task;
+    scheduler_requeue(task);
+    
+    spin_unlock_irqrestore(&reserve_list_lock, flags);
+    
+    return SUCCESS;
+}
+
+/* Take a task out of its reservation */
+int32_t reserve_detach(task_t *task) {
+    reserve_t *res;
+    task_t **link;
+    irq_flags_t flags;
+    
+    if (!task) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&reserve_list_lock);
+    
+    res = task->reserve;
+    if (!res) {
+        spin_unlock_irqrestore(&reserve_list_lock, flags);
+        return ERROR;
+    }
+    
+    for (link = &res->members; *link; link = &(*link)->next_reserved) {
+        if (*link == task) {
+            *link = task->next_reserved;
+            break;
+        }
+    }
+    task->reserve = NULL;
+    task->next_reserved = NULL;
+    scheduler_requeue(task);
+    
+    spin_unlock_irqrestore(&reserve_list_lock, flags);
+    
+    return SUCCESS;
+}
+
+/* Get the first reservation (follow next for the rest) */
+reserve_t *reserve_get_list(void) {
+    return reserve_head;
+}
@@ -1,26 +1,66 @@
 #include "../include/scheduler.h"
 #include "../include/task.h"
+#include "../include/smp.h"
+#include "../include/spinlock.h"
+#include "../include/bitops.h"
+#include "../include/waitq.h"
+#include "../include/defer.h"
+#include "../include/irq.h"
+#include "../include/timer.h"
+#include "../include/reserve.h"
+#include "../include/cyclic.h"
 #include "../include/memory.h"
+#include "../include/tsc.h"
 #include "../include/io.h"
 
 /* External assembly functions */
 extern void context_switch(cpu_context_t *old_ctx, cpu_context_t *new_ctx);
 extern void setup_idt(void);
-extern void enable_interrupts(void);
-extern void disable_interrupts(void);
 
-/* External task function */
-extern void task_set_current(task_t *task);
+#define CPU_ALLOWED(task, id)   ((task)->affinity & (1U << (id)))
 
-/* Ready queue per priority level */
-static task_t *ready_queue[MAX_PRIORITY + 1];
+/* Tick comparison that survives counter wrap-around */
+#define TICK_BEFORE(a, b)       ((int32_t)((a) - (b)) < 0)
+
+/* Ready-queue level: cyclic tasks sit above every priority; a throttled
+ * reservation runs in the background unless its task is boosted by
+ * priority inheritance */
+#define TASK_LEVEL(task)        ((task)->sched_class == SCHED_CYCLIC ? CYCLIC_LEVEL : \
+                                 (task)->reserve && (task)->reserve->throttled && \
+                                 (task)->priority == (task)->base_priority ? \
+                                 RESERVE_BACKGROUND_PRIORITY : (task)->priority)
+
+/* EDF task competing by deadline (not boosted off its level) */
+#define IS_EDF(task)            ((task)->sched_class == SCHED_EDF && \
+                                 (task)->priority == EDF_PRIORITY)
+
+/* Fair-share task competing by virtual runtime (not boosted) */
+#define IS_FAIR(task)           ((task)->sched_class == SCHED_FAIR && \
+                                 (task)->priority == FAIR_PRIORITY)
+
+/* Virtual runtime of n ticks at the default weight */
+#define FAIR_TICKS(n)           ((n) * FAIR_WEIGHT_DEFAULT)
+
+/* Sleeping tasks; ready tasks live on the per-CPU queues in cpu_t
+ *
+ * Lock order: blocked_lock, then a CPU lock; a second CPU lock is only
+ * ever taken with spin_trylock().
+ */
 static task_t *blocked_queue = NULL;
-static task_t *current_task = NULL;
+static spinlock_t blocked_lock;
+
+/* Held by whichever CPU has preemption disabled; guards all IPC objects */
+static spinlock_t kernel_lock;
 
-static uint32_t tick_count = 0;
-static uint32_t task_count = 0;
-static bool_t preemption_enabled = TRUE;
-static bool_t scheduler_running = FALSE;
+/* Guards the per-CPU EDF utilization totals */
+static spinlock_t admit_lock;
+
+static volatile uint32_t tick_count = 0;
+static volatile uint32_t tick_tsc = 0;   /* TSC (low half) at the last tick */
+static volatile uint32_t task_count = 0;
+static volatile bool_t scheduler_running = FALSE;
+
+static isr_defer_t tick_work;
 
 /* Add task to end of priority queue */
 static void add_to_queue(task_t **queue, task_t *task) {
@@ -57,36 +97,450 @@ static void remove_from_queue(task_t **queue, task_t *task) {
     task->prev = NULL;
 }
 
-/* Get next ready task (highest priority, round-robin within priority) */
-static task_t *get_next_task(void) {
-    int32_t i;
-    task_t *task;
+/* Check whether an EDF or fair task sorts in front of pos on its level:
+ * by deadline or virtual runtime, ahead of any fixed-priority task */
+static bool_t queue_before(task_t *task, task_t *pos) {
+    if (IS_EDF(task)) {
+        return !IS_EDF(pos) || TICK_BEFORE(task->abs_deadline, pos->abs_deadline);
+    }
+    
+    return !IS_FAIR(pos) || TICK_BEFORE(task->vruntime, pos->vruntime);
+}
+
+/* Insert an EDF or fair task in key order, after equal keys */
+static void add_to_ordered_queue(task_t **queue, task_t *task) {
+    task_t *head = *queue;
+    task_t *pos;
+    
+    if (!head || queue_before(task, head)) {
+        /* New smallest key: the tail slot becomes the head */
+        add_to_queue(queue, task);
+        *queue = task;
+        return;
+    }
+    
+    pos = head->next;
+    while (pos != head && !queue_before(task, pos)) {
+        pos = pos->next;
+    }
+    
+    /* Link in front of pos (in front of the head is the tail) */
+    task->next = pos;
+    task->prev = pos->prev;
+    pos->prev->next = task;
+    pos->prev = task;
+}
+
+/* Put a task on a CPU's ready queue (CPU lock held) */
+static void enqueue_task(cpu_t *cpu, task_t *task) {
+    task->level = TASK_LEVEL(task);
+    if (IS_EDF(task) || IS_FAIR(task)) {
+        add_to_ordered_queue(&cpu->ready[task->level], task);
+    } else {
+        add_to_queue(&cpu->ready[task->level], task);
+    }
+    cpu->ready_bitmap |= (1U << task->level);
+    cpu->nr_ready++;
+    task->cpu = cpu->id;
+    task->state = TASK_READY;
+}
+
+/* Take a task off a CPU's ready queue (CPU lock held) */
+static void dequeue_task(cpu_t *cpu, task_t *task) {
+    remove_from_queue(&cpu->ready[task->level], task);
+    if (!cpu->ready[task->level]) {
+        cpu->ready_bitmap &= ~(1U << task->level);
+    }
+    cpu->nr_ready--;
+}
+
+/* Lock the CPU a task is queued or running on */
+static cpu_t *lock_task_cpu(task_t *task) {
+    cpu_t *cpu;
+    
+    for (;;) {
+        cpu = cpu_get(task->cpu);
+        spin_lock(&cpu->lock);
+        if (task->cpu == cpu->id) {
+            return cpu;
+        }
+        /* Stolen while we waited */
+        spin_unlock(&cpu->lock);
+    }
+}
+
+/* Check whether a CPU is running only its idle task */
+static bool_t cpu_is_idle(cpu_t *cpu) {
+    return cpu->current == cpu->idle && cpu->nr_ready == 0;
+}
+
+/* Check whether task should run ahead of another: higher level first, then
+ * EDF tasks by earliest deadline */
+static bool_t task_preempts(task_t *task, task_t *other) {
+    if (TASK_LEVEL(task) != TASK_LEVEL(other)) {
+        return TASK_LEVEL(task) > TASK_LEVEL(other);
+    }
+    
+    if (IS_FAIR(task)) {
+        /* A fair task needs a clear lead to take over from another */
+        return !IS_FAIR(other) ||
+               TICK_BEFORE(task->vruntime + FAIR_TICKS(FAIR_GRANULARITY), other->vruntime);
+    }
+    
+    return IS_EDF(task) &&
+           (!IS_EDF(other) || TICK_BEFORE(task->abs_deadline, other->abs_deadline));
+}
+
+/* Put a fair task back on a CPU's timeline as it wakes (CPU lock held)
+ *
+ * While blocked (or suspended) its vruntime is kept relative to the old
+ * CPU's floor. It keeps that place, but never more than the time it slept
+ * (up to FAIR_SLEEPER_CREDIT ticks) behind the floor. The credit is a
+ * bound, not a bonus, so repeated short sleeps cannot build up a lead
+ * over CPU-bound tasks.
+ */
+static void fair_wake(cpu_t *cpu, task_t *task) {
+    uint32_t slept = tick_count - task->fair_sleep;
+    uint32_t floor;
+    
+    if (slept > FAIR_SLEEPER_CREDIT) {
+        slept = FAIR_SLEEPER_CREDIT;
+    }
+    
+    floor = cpu->min_vruntime - FAIR_TICKS(slept);
+    task->vruntime += cpu->min_vruntime;
+    if (TICK_BEFORE(task->vruntime, floor)) {
+        task->vruntime = floor;
+    }
+}
+
+/* Charge a tick to the running fair task (CPU lock held)
+ *
+ * Virtual time runs slower the heavier the task, so the CPU divides in
+ * proportion to weight. Returns TRUE once the leftmost waiting task has
+ * a clear lead.
+ */
+static bool_t fair_charge(cpu_t *cpu, task_t *task) {
+    task_t *first = cpu->ready[FAIR_PRIORITY];
+    uint32_t floor;
+    
+    task->vruntime += (FAIR_WEIGHT_DEFAULT * FAIR_WEIGHT_DEFAULT) / task->fair_weight;
+    task->fair_ticks++;
+    
+    /* The floor follows the smallest vruntime on the CPU, never back */
+    floor = task->vruntime;
+    if (first && IS_FAIR(first)) {
+        if (TICK_BEFORE(first->vruntime, floor)) {
+            floor = first->vruntime;
+        }
+    } else {
+        first = NULL;
+    }
+    if (TICK_BEFORE(cpu->min_vruntime, floor)) {
+        cpu->min_vruntime = floor;
+    }
+    
+    return first && task_preempts(first, task);
+}
+
+/* Ask a CPU to reschedule, interrupting it if it is not us */
+static void resched_cpu(cpu_t *cpu) {
+    cpu->need_resched = TRUE;
+    
+    if (cpu != cpu_self()) {
+        smp_send_resched(cpu);
+    }
+}
+
+/* Choose the CPU a woken or new task should be queued on
+ *
+ * A task still being switched out stays where it is. Otherwise its last
+ * CPU is kept while idle (warm cache), then any idle CPU it may use.
+ */
+static cpu_t *select_cpu(task_t *task) {
+    cpu_t *last = cpu_get(task->cpu);
+    cpu_t *cpu;
+    uint32_t i;
+    
+    if (task->on_cpu) {
+        return last;
+    }
+    
+    if (CPU_ALLOWED(task, last->id) && cpu_is_idle(last)) {
+        return last;
+    }
+    
+    for (i = 0; i < smp_cpu_count(); i++) {
+        cpu = cpu_get(i);
+        if (cpu->online && CPU_ALLOWED(task, i) && cpu_is_idle(cpu)) {
+            return cpu;
+        }
+    }
+    
+    if (CPU_ALLOWED(task, last->id)) {
+        return last;
+    }
+    
+    for (i = 0; i < smp_cpu_count(); i++) {
+        cpu = cpu_get(i);
+        if (cpu->online && CPU_ALLOWED(task, i)) {
+            return cpu;
+        }
+    }
+    
+    return last;
+}
+
+/* Queue a task that was off the ready queues, preempting if it outranks
+ * the running task (blocked_lock held) */
+static void wake_task(task_t *task) {
+    cpu_t *cpu;
+    
+    cpu = select_cpu(task);
+    spin_lock(&cpu->lock);
+    if (task->sched_class == SCHED_FAIR) {
+        fair_wake(cpu, task);
+    }
+    enqueue_task(cpu, task);
+    
+    /* Preempt at the next opportunity if it outranks the running task */
+    if (!cpu->current || cpu->current == cpu->idle ||
+        task_preempts(task, cpu->current)) {
+        resched_cpu(cpu);
+    }
+    
+    spin_unlock(&cpu->lock);
+}
+
+/* Move a blocked task to a ready queue (blocked_lock held) */
+static void unblock_task(task_t *task) {
+    /* Already woken (e.g. timeout and post racing) */
+    if (task->state != TASK_BLOCKED) {
+        return;
+    }
+    
+    remove_from_queue(&blocked_queue, task);
+    
+    /* Suspended while it slept: the wake-up is kept for task_resume() */
+    if (task->suspended) {
+        task->state = TASK_SUSPENDED;
+        return;
+    }
+    
+    wake_task(task);
+}
+
+/* Find the CPU with the most ready tasks other than self */
+static cpu_t *busiest_cpu(cpu_t *self) {
+    cpu_t *busiest = NULL;
+    cpu_t *cpu;
+    uint32_t i;
     
-    for (i = MAX_PRIORITY; i >= 0; i--) {
-        if (ready_queue[i]) {
-            task = ready_queue[i];
-            ready_queue[i] = task->next;  /* Round-robin */
-            return task;
+    for (i = 0; i < smp_cpu_count(); i++) {
+        cpu = cpu_get(i);
+        if (cpu != self && cpu->online && cpu->nr_ready > 0 &&
+            (!busiest || cpu->nr_ready > busiest->nr_ready)) {
+            busiest = cpu;
         }
     }
     
-    return NULL;
+    return busiest;
+}
+
+/* Pull the highest-priority task we may run from the busiest CPU
+ *
+ * Called with our own lock held, so the victim's lock is only tried; on
+ * contention we go idle and retry at the next tick.
+ */
+static task_t *steal_task(cpu_t *self) {
+    cpu_t *victim = busiest_cpu(self);
+    task_t *task = NULL;
+    task_t *t;
+    uint32_t pending;
+    uint32_t lvl;
+    
+    if (!victim || !spin_trylock(&victim->lock)) {
+        return NULL;
+    }
+    
+    pending = victim->ready_bitmap;
+    while (pending && !task) {
+        lvl = bit_highest(pending);
+        pending &= ~(1U << lvl);
+        
+        t = victim->ready[lvl];
+        do {
+            if (!t->on_cpu && CPU_ALLOWED(t, self->id)) {
+                task = t;
+                break;
+            }
+            t = t->next;
+        } while (t != victim->ready[lvl]);
+    }
+    
+    if (task) {
+        dequeue_task(victim, task);
+        if (task->sched_class == SCHED_FAIR) {
+            /* Keep its place relative to the floor of its new timeline */
+            task->vruntime = task->vruntime - victim->min_vruntime + self->min_vruntime;
+        }
+        task->cpu = self->id;
+        self->steals++;
+    }
+    
+    spin_unlock(&victim->lock);
+    
+    return task;
+}
+
+/* Take next task for this CPU (CPU lock held)
+ *
+ * The running task is not kept on a ready queue; schedule() puts it back at
+ * the tail of its level when it is preempted.
+ */
+static task_t *get_next_task(cpu_t *cpu) {
+    task_t *task;
+    
+    if (cpu->ready_bitmap) {
+        task = cpu->ready[bit_highest(cpu->ready_bitmap)];
+        dequeue_task(cpu, task);
+        return task;
+    }
+    
+    task = steal_task(cpu);
+    
+    return task ? task : cpu->idle;
+}
+
+/* Finish a context switch on the incoming task's stack */
+static void schedule_tail(void) {
+    cpu_t *cpu = cpu_self();
+    
+    /* Its context is saved now, so other CPUs may pick it up */
+    if (cpu->prev_task) {
+        cpu->prev_task->on_cpu = FALSE;
+        cpu->prev_task = NULL;
+    }
+    
+    spin_unlock(&cpu->lock);
+}
+
+/* Switch this CPU from old to new (CPU lock held, released on return) */
+static void switch_to(cpu_t *cpu, task_t *old_task, task_t *new_task) {
+    new_task->state = TASK_RUNNING;
+    new_task->time_slice = TIME_SLICE_MS;
+    new_task->cpu = cpu->id;
+    new_task->on_cpu = TRUE;
+    cpu->current = new_task;
+    
+    if (old_task == new_task) {
+        spin_unlock(&cpu->lock);
+        return;
+    }
+    
+    /* Suspended while running, it leaves the fair timeline only now */
+    if (old_task && old_task->state == TASK_SUSPENDED &&
+        old_task->sched_class == SCHED_FAIR) {
+        old_task->vruntime -= cpu->min_vruntime;
+        old_task->fair_sleep = tick_count;
+    }
+    
+    cpu->prev_task = old_task;
+    cpu->switches++;
+    
+    context_switch(old_task ? &old_task->context : NULL, &new_task->context);
+    
+    schedule_tail();
+}
+
+/* Take the kernel lock for this CPU (interrupts disabled) */
+static void kernel_lock_acquire(cpu_t *cpu) {
+    spin_lock(&kernel_lock);
+    cpu->preempt_off = TRUE;
+}
+
+/* Drop the kernel lock (interrupts disabled) */
+static void kernel_lock_release(cpu_t *cpu) {
+    cpu->preempt_off = FALSE;
+    spin_unlock(&kernel_lock);
+}
+
+/* Run work deferred by interrupt handlers on this CPU (preemption enabled)
+ *
+ * The kernel lock is held while the items run, so an interrupt arriving
+ * meanwhile neither reschedules nor re-enters the drain; its own items are
+ * picked up by this loop. Returns with IF clear.
+ */
+static void run_deferred(cpu_t *cpu) {
+    kernel_lock_acquire(cpu);
+    defer_run();
+    kernel_lock_release(cpu);
+}
+
+/* Wake tasks whose timeout expired (deferred from the timer tick) */
+static void wake_sleepers(void *arg) {
+    task_t *task;
+    task_t *next;
+    task_t *last;
+    bool_t done;
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&blocked_lock);
+    
+    /* The list shrinks as we go, so stop at the task that was last when
+     * the walk started */
+    task = blocked_queue;
+    if (task) {
+        last = task->prev;
+        do {
+            next = task->next;
+            done = (task == last);
+            if (task->wake_time > 0 && tick_count >= task->wake_time) {
+                task->wake_time = 0;
+                unblock_task(task);
+            }
+            task = next;
+        } while (!done);
+    }
+    
+    spin_unlock_irqrestore(&blocked_lock, flags);
 }
 
 /* Initialize scheduler */
 void scheduler_init(void) {
-    int32_t i;
+    cpu_t *cpu;
+    uint32_t i;
+    uint32_t j;
     
-    for (i = 0; i <= MAX_PRIORITY; i++) {
-        ready_queue[i] = NULL;
+    for (i = 0; i < MAX_CPUS; i++) {
+        cpu = cpu_get(i);
+        for (j = 0; j < SCHED_LEVELS; j++) {
+            cpu->ready[j] = NULL;
+        }
+        cpu->ready_bitmap = 0;
+        cpu->nr_ready = 0;
+        cpu->edf_util = 0;
+        cpu->min_vruntime = 0;
+        cpu->current = NULL;
+        cpu->idle = NULL;
+        cpu->prev_task = NULL;
+        cpu->irq_nesting = 0;
+        cpu->need_resched = FALSE;
+        cpu->preempt_off = FALSE;
+        spin_init(&cpu->lock);
     }
     
+    /* The boot CPU schedules from the start; APs join in smp_init() */
+    cpu_get(0)->online = TRUE;
+    
     blocked_queue = NULL;
-    current_task = NULL;
+    spin_init(&blocked_lock);
+    spin_init(&kernel_lock);
+    spin_init(&admit_lock);
     tick_count = 0;
     task_count = 0;
-    preemption_enabled = TRUE;
     scheduler_running = FALSE;
+    defer_item_init(&tick_work, "tick", wake_sleepers, NULL, 0);
     
     /* Setup interrupt descriptor table */
     setup_idt();
@@ -95,175 +549,693 @@ void scheduler_init(void) {
 /* Start scheduler (enables interrupts) */
 void scheduler_start(void) {
     scheduler_running = TRUE;
-    enable_interrupts();
+    irq_enable();
     
     /* Initial schedule */
     schedule();
 }
 
-/* Timer tick handler */
-void scheduler_tick_handler(void) {
-    task_t *task;
-    task_t *next;
+/* Join the scheduler on an application processor once the BSP starts it */
+void scheduler_start_ap(void) {
+    while (!scheduler_running) {
+        __asm__ volatile("pause");
+    }
+    
+    irq_enable();
+    schedule();
+}
+
+/* First code run by a new task: finish the switch that started it */
+void scheduler_task_start(void) {
+    schedule_tail();
+    irq_enable();
+}
+
+/* Make task the idle task of a CPU (before the scheduler starts) */
+void scheduler_set_idle(cpu_t *cpu, task_t *task) {
+    cpu_t *queued;
+    irq_flags_t flags;
     
+    if (!cpu || !task) {
+        return;
+    }
+    
+    flags = irq_save();
+    
+    queued = lock_task_cpu(task);
+    if (task->state == TASK_READY) {
+        dequeue_task(queued, task);
+    }
+    task->affinity = (1U << cpu->id);
+    task->cpu = cpu->id;
+    spin_unlock(&queued->lock);
+    
+    cpu->idle = task;
+    
+    irq_restore(flags);
+}
+
+/* Timer tick handler (PIT interrupt on the boot CPU)
+ *
+ * Advances system time, then charges the boot CPU's time slice; waking
+ * sleepers runs after the EOI and any reschedule happens in
+ * scheduler_irq_exit().
+ */
+void scheduler_tick_handler(void) {
+    tick_tsc = tsc_read32();
     tick_count++;
     
-    /* Wake up sleeping tasks */
-    task = blocked_queue;
-    if (task) {
-        do {
-            next = task->next;
-            if (task->wake_time > 0 && tick_count >= task->wake_time) {
-                task->wake_time = 0;
-                scheduler_unblock_task(task);
-            }
-            task = next;
-        } while (task != blocked_queue && task);
+    /* Time-triggered dispatch first, for the least jitter */
+    cyclic_tick_from_isr();
+    
+    if (blocked_queue) {
+        defer_queue_from_isr(&tick_work);
+    }
+    timer_tick_from_isr(tick_count);
+    reserve_tick_from_isr(tick_count);
+    
+    scheduler_local_tick();
+}
+
+/* Per-CPU tick: charge the running task's time slice (interrupt context) */
+void scheduler_local_tick(void) {
+    cpu_t *cpu = cpu_self();
+    task_t *current = cpu->current;
+    bool_t preempt;
+    
+    cpu->ticks++;
+    
+    /* Reservations pay for every tick, preemptible or not (the unlocked
+     * check only skips the lock for tasks without one) */
+    if (current && current->reserve && current != cpu->idle) {
+        reserve_charge_from_isr(current, tick_count);
+    }
+    
+    if (!current || cpu->preempt_off) {
+        return;
     }
     
-    /* Decrement time slice of current task */
-    if (current_task && preemption_enabled) {
-        if (current_task->time_slice > 0) {
-            current_task->time_slice--;
+    /* An idle CPU looks for work to steal every tick */
+    if (current == cpu->idle) {
+        if (busiest_cpu(cpu)) {
+            cpu->need_resched = TRUE;
         }
+        return;
+    }
+    
+    /* A cyclic task runs its slot to the end: nothing shares its level */
+    if (current->sched_class == SCHED_CYCLIC) {
+        return;
+    }
+    
+    /* Count a late job once, as soon as it overruns */
+    if (current->sched_class == SCHED_EDF && !current->deadline_missed &&
+        TICK_BEFORE(current->abs_deadline, tick_count)) {
+        current->deadline_missed = TRUE;
+        current->deadline_misses++;
+    }
+    
+    /* Fair tasks are preempted by virtual runtime, not time slice */
+    if (current->sched_class == SCHED_FAIR) {
+        spin_lock(&cpu->lock);
+        preempt = fair_charge(cpu, current);
+        spin_unlock(&cpu->lock);
         
-        if (current_task->time_slice == 0) {
-            /* Time slice expired, trigger reschedule */
-            schedule();
+        /* Boosted by priority inheritance, it round-robins like the rest */
+        if (IS_FAIR(current)) {
+            if (preempt) {
+                cpu->need_resched = TRUE;
+            }
+            return;
         }
     }
+    
+    if (current->time_slice > 0) {
+        current->time_slice--;
+    }
+    
+    if (current->time_slice == 0) {
+        /* Time slice expired, reschedule on the way out */
+        cpu->need_resched = TRUE;
+    }
 }
 
 /* Main scheduling function */
 void schedule(void) {
+    cpu_t *cpu;
     task_t *old_task;
     task_t *new_task;
+    irq_flags_t flags;
     
     if (!scheduler_running) {
         return;
     }
     
-    disable_interrupts();
+    /* Saved on the old task's stack, so each task gets its own state back */
+    flags = irq_save();
     
-    old_task = current_task;
+    cpu = cpu_self();
+    spin_lock(&cpu->lock);
+    
+    cpu->need_resched = FALSE;
+    old_task = cpu->current;
     
     /* Put current task back in ready queue if still runnable */
-    if (old_task && old_task->state == TASK_RUNNING) {
-        old_task->state = TASK_READY;
+    if (old_task && old_task->state == TASK_RUNNING && old_task != cpu->idle) {
         old_task->time_slice = TIME_SLICE_MS;
-        add_to_queue(&ready_queue[old_task->priority], old_task);
+        enqueue_task(cpu, old_task);
     }
     
     /* Get next task to run */
-    new_task = get_next_task();
+    new_task = get_next_task(cpu);
     
     if (new_task) {
-        new_task->state = TASK_RUNNING;
-        new_task->time_slice = TIME_SLICE_MS;
-        current_task = new_task;
-        task_set_current(new_task);
+        switch_to(cpu, old_task, new_task);
+    } else {
+        /* No task to run, idle */
+        cpu->current = NULL;
+        spin_unlock(&cpu->lock);
+    }
+    
+    irq_restore(flags);
+}
+
+/* Move a task to the blocked list (blocked_lock and its CPU lock held) */
+static void block_task(cpu_t *cpu, task_t *task) {
+    /* Remove from ready queue (the running task is on none) */
+    if (task->state == TASK_READY) {
+        dequeue_task(cpu, task);
+    }
+    
+    /* Off the timeline while asleep; fair_wake() puts it back */
+    if (task->sched_class == SCHED_FAIR) {
+        task->vruntime -= cpu->min_vruntime;
+        task->fair_sleep = tick_count;
+    }
+    
+    /* Add to blocked queue */
+    task->state = TASK_BLOCKED;
+    add_to_queue(&blocked_queue, task);
+}
+
+/* Switch straight to next, blocking the current task first if asked */
+static void handoff(task_t *next, bool_t block) {
+    cpu_t *cpu;
+    task_t *old_task;
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&blocked_lock);
+    cpu = cpu_self();
+    spin_lock(&cpu->lock);
+    
+    old_task = cpu->current;
+    
+    /* Blocked in the same critical section as the switch, so the caller
+     * can never be switched out blocked with next still asleep */
+    if (block && old_task && old_task != cpu->idle &&
+        old_task->state == TASK_RUNNING) {
+        block_task(cpu, old_task);
+    }
+    
+    if (old_task && old_task != next && next->state == TASK_BLOCKED &&
+        !next->suspended && !next->on_cpu && CPU_ALLOWED(next, cpu->id)) {
+        if (old_task->state == TASK_RUNNING && old_task != cpu->idle) {
+            old_task->time_slice = TIME_SLICE_MS;
+            enqueue_task(cpu, old_task);
+        }
         
-        /* Context switch */
-        if (old_task != new_task) {
-            if (old_task) {
-                context_switch(&old_task->context, &new_task->context);
-            } else {
-                context_switch(NULL, &new_task->context);
+        /* Never let the hand-off jump ahead of a higher-priority task */
+        if (!cpu->ready_bitmap ||
+            !task_preempts(cpu->ready[bit_highest(cpu->ready_bitmap)], next)) {
+            remove_from_queue(&blocked_queue, next);
+            spin_unlock(&blocked_lock);
+            if (next->sched_class == SCHED_FAIR) {
+                fair_wake(cpu, next);
             }
+            
+            switch_to(cpu, old_task, next);
+            irq_restore(flags);
+            return;
         }
-    } else {
-        /* No task to run, idle */
-        current_task = NULL;
-        task_set_current(NULL);
     }
     
-    enable_interrupts();
+    spin_unlock(&cpu->lock);
+    unblock_task(next);
+    spin_unlock_irqrestore(&blocked_lock, flags);
+    
+    schedule();
+}
+
+/* Switch straight to a blocked task, bypassing the ready queues
+ *
+ * Used by synchronous IPC so a client/server pair does not round-trip
+ * through the scheduler. The caller keeps its place in the ready queue (or
+ * stays blocked); if something of higher priority than next is ready, or
+ * next may not run here, next is just made ready and a normal reschedule
+ * happens instead.
+ */
+void scheduler_handoff(task_t *next) {
+    if (!scheduler_running || !next) {
+        return;
+    }
+    
+    handoff(next, FALSE);
+}
+
+/* Block the current task and switch straight to next
+ *
+ * Like scheduler_handoff(), but the caller blocks as part of the switch
+ * rather than beforehand, so a reschedule in between cannot strand it.
+ */
+void scheduler_handoff_block(task_t *next) {
+    if (!scheduler_running || !next) {
+        return;
+    }
+    
+    handoff(next, TRUE);
 }
 
 /* Add task to ready queue */
 void scheduler_add_task(task_t *task) {
+    cpu_t *cpu;
+    irq_flags_t flags;
+    
     if (!task) {
         return;
     }
     
-    disable_interrupts();
-    task->state = TASK_READY;
-    add_to_queue(&ready_queue[task->priority], task);
-    task_count++;
-    enable_interrupts();
+    flags = irq_save();
+    
+    cpu = select_cpu(task);
+    spin_lock(&cpu->lock);
+    if (task->sched_class == SCHED_FAIR) {
+        /* New tasks start level with the CPU, without sleeper credit */
+        task->vruntime += cpu->min_vruntime;
+    }
+    enqueue_task(cpu, task);
+    if (scheduler_running && cpu_is_idle(cpu)) {
+        resched_cpu(cpu);
+    }
+    spin_unlock(&cpu->lock);
+    
+    atomic_fetch_add(&task_count, 1);
+    
+    irq_restore(flags);
 }
 
 /* Remove task from scheduler */
 void scheduler_remove_task(task_t *task) {
-    int32_t i;
+    cpu_t *cpu;
+    irq_flags_t flags;
     
     if (!task) {
         return;
     }
     
-    disable_interrupts();
+    flags = spin_lock_irqsave(&blocked_lock);
+    cpu = lock_task_cpu(task);
     
-    /* Remove from ready queue */
-    for (i = 0; i <= MAX_PRIORITY; i++) {
-        if (ready_queue[i]) {
-            remove_from_queue(&ready_queue[i], task);
-        }
+    if (task->state == TASK_READY) {
+        dequeue_task(cpu, task);
+    } else if (task->state == TASK_BLOCKED) {
+        remove_from_queue(&blocked_queue, task);
     }
+    task->state = TASK_TERMINATED;
     
-    /* Remove from blocked queue */
-    remove_from_queue(&blocked_queue, task);
+    spin_unlock(&cpu->lock);
+    spin_unlock_irqrestore(&blocked_lock, flags);
+    
+    /* Drop out of any kernel object wait queues */
+    scheduler_disable_preemption();
+    waitq_cancel(task);
+    scheduler_enable_preemption();
+    
+    /* An exiting task may still be switching out on another CPU */
+    while (task->on_cpu && task != scheduler_get_current()) {
+        __asm__ volatile("pause");
+    }
     
     if (task_count > 0) {
-        task_count--;
+        atomic_fetch_add(&task_count, (uint32_t)-1);
     }
     
-    enable_interrupts();
+    /* Give back its share of the CPU */
+    if (task->sched_class == SCHED_EDF && task->edf_util) {
+        flags = spin_lock_irqsave(&admit_lock);
+        cpu_get(task->cpu)->edf_util -= task->edf_util;
+        task->edf_util = 0;
+        spin_unlock_irqrestore(&admit_lock, flags);
+    }
 }
 
 /* Block a task */
 void scheduler_block_task(task_t *task) {
+    cpu_t *cpu;
+    irq_flags_t flags;
+    
     if (!task) {
         return;
     }
     
-    disable_interrupts();
-    task->state = TASK_BLOCKED;
-    
-    /* Remove from ready queue */
-    remove_from_queue(&ready_queue[task->priority], task);
+    flags = spin_lock_irqsave(&blocked_lock);
     
-    /* Add to blocked queue */
-    add_to_queue(&blocked_queue, task);
+    if (task->state == TASK_BLOCKED) {
+        spin_unlock_irqrestore(&blocked_lock, flags);
+        return;
+    }
     
-    enable_interrupts();
+    cpu = lock_task_cpu(task);
+    block_task(cpu, task);
+    spin_unlock(&cpu->lock);
+    spin_unlock_irqrestore(&blocked_lock, flags);
 }
 
 /* Unblock a task */
 void scheduler_unblock_task(task_t *task) {
+    irq_flags_t flags;
+    
     if (!task) {
         return;
     }
     
-    disable_interrupts();
+    flags = spin_lock_irqsave(&blocked_lock);
+    unblock_task(task);
+    spin_unlock_irqrestore(&blocked_lock, flags);
+}
+
+/* Unblock a task from interrupt context (leaves IF untouched) */
+void scheduler_unblock_task_from_isr(task_t *task) {
+    scheduler_unblock_task(task);
+}
+
+/* Take a task off the ready queues until scheduler_resume_task()
+ *
+ * A ready task is dequeued; a running one is left off when it next
+ * switches out; a blocked one is parked when it wakes. Idle tasks and
+ * terminated tasks cannot be suspended.
+ */
+int32_t scheduler_suspend_task(task_t *task) {
+    cpu_t *cpu;
+    int32_t result = SUCCESS;
+    irq_flags_t flags;
     
-    /* Remove from blocked queue */
-    remove_from_queue(&blocked_queue, task);
+    if (!task) {
+        return ERROR;
+    }
     
-    /* Add to ready queue */
-    task->state = TASK_READY;
-    add_to_queue(&ready_queue[task->priority], task);
+    flags = spin_lock_irqsave(&blocked_lock);
+    cpu = lock_task_cpu(task);
+    
+    if (task->state == TASK_TERMINATED || task == cpu->idle) {
+        result = ERROR;
+    } else {
+        task->suspended = TRUE;
+        
+        if (task->state == TASK_READY) {
+            dequeue_task(cpu, task);
+            task->state = TASK_SUSPENDED;
+            if (task->sched_class == SCHED_FAIR) {
+                task->vruntime -= cpu->min_vruntime;
+                task->fair_sleep = tick_count;
+            }
+        } else if (task->state == TASK_RUNNING) {
+            task->state = TASK_SUSPENDED;
+            resched_cpu(cpu);
+        }
+    }
+    
+    spin_unlock(&cpu->lock);
+    spin_unlock_irqrestore(&blocked_lock, flags);
+    
+    if (result == SUCCESS && task == scheduler_get_current()) {
+        schedule();
+    }
+    
+    return result;
+}
+
+/* Put a suspended task back on a ready queue
+ *
+ * A task still blocked stays blocked; one that has not switched out yet
+ * just carries on running.
+ */
+int32_t scheduler_resume_task(task_t *task) {
+    cpu_t *cpu;
+    int32_t result = SUCCESS;
+    irq_flags_t flags;
+    
+    if (!task) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&blocked_lock);
+    cpu = lock_task_cpu(task);
+    
+    if (!task->suspended) {
+        result = ERROR;
+        spin_unlock(&cpu->lock);
+    } else if (task->state == TASK_SUSPENDED && cpu->current == task) {
+        task->suspended = FALSE;
+        task->state = TASK_RUNNING;
+        spin_unlock(&cpu->lock);
+    } else {
+        task->suspended = FALSE;
+        spin_unlock(&cpu->lock);
+        if (task->state == TASK_SUSPENDED) {
+            wake_task(task);
+        }
+    }
+    
+    spin_unlock_irqrestore(&blocked_lock, flags);
+    
+    return result;
+}
+
+/* Change a task's effective priority, moving it between queues */
+void scheduler_set_priority(task_t *task, uint8_t priority) {
+    cpu_t *cpu;
+    irq_flags_t flags;
+    
+    if (!task || priority > MAX_PRIORITY) {
+        return;
+    }
+    
+    flags = irq_save();
+    cpu = lock_task_cpu(task);
+    
+    if (task->state == TASK_READY) {
+        dequeue_task(cpu, task);
+        task->priority = priority;
+        enqueue_task(cpu, task);
+        
+        /* A boosted task may now outrank what its CPU is running */
+        if (cpu->current && task_preempts(task, cpu->current)) {
+            resched_cpu(cpu);
+        }
+    } else {
+        task->priority = priority;
+    }
+    
+    spin_unlock(&cpu->lock);
+    
+    /* Keep priority-ordered wait queues sorted */
+    if (task->wait_node.queue) {
+        waitq_requeue(task);
+    }
+    
+    irq_restore(flags);
+}
+
+/* Re-file a task at the level its reservation state calls for */
+void scheduler_requeue(task_t *task) {
+    cpu_t *cpu;
+    irq_flags_t flags;
+    
+    if (!task) {
+        return;
+    }
+    
+    flags = irq_save();
+    cpu = lock_task_cpu(task);
+    
+    if (task->state == TASK_READY && task->level != TASK_LEVEL(task)) {
+        dequeue_task(cpu, task);
+        enqueue_task(cpu, task);
+    }
+    
+    /* Let its CPU rank it again against what is running and queued */
+    if (cpu->current == task ||
+        (task->state == TASK_READY && cpu->current &&
+         task_preempts(task, cpu->current))) {
+        resched_cpu(cpu);
+    }
+    
+    spin_unlock(&cpu->lock);
+    irq_restore(flags);
+}
+
+/* Admit an EDF task with the given utilization (before it is added)
+ *
+ * Partitioned EDF: the task is placed on the first CPU whose admitted
+ * total stays within EDF_UTIL_MAX and is pinned there, so each CPU meets
+ * every deadline as long as its own total does. Higher fixed-priority
+ * levels are not counted and must leave room for it.
+ */
+int32_t scheduler_admit_edf(task_t *task, uint32_t util) {
+    cpu_t *cpu;
+    uint32_t i;
+    int32_t result = ERROR;
+    irq_flags_t flags;
+    
+    if (!task || util == 0 || util > EDF_UTIL_MAX) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&admit_lock);
+    
+    for (i = 0; i < smp_cpu_count(); i++) {
+        cpu = cpu_get(i);
+        if (cpu->online && cpu->edf_util + util <= EDF_UTIL_MAX) {
+            cpu->edf_util += util;
+            task->edf_util = util;
+            task->cpu = i;
+            task->affinity = (1U << i);
+            result = SUCCESS;
+            break;
+        }
+    }
     
-    enable_interrupts();
+    spin_unlock_irqrestore(&admit_lock, flags);
+    
+    return result;
 }
 
-/* Disable preemption */
+/* Disable preemption
+ *
+ * Takes the kernel lock for this CPU, so tasks on other CPUs wait here
+ * rather than touch IPC objects at the same time. Not nestable: a second
+ * call on the same CPU is a no-op.
+ */
 void scheduler_disable_preemption(void) {
-    preemption_enabled = FALSE;
+    cpu_t *cpu;
+    irq_flags_t flags;
+    
+    for (;;) {
+        flags = irq_save();
+        cpu = cpu_self();
+        
+        if (cpu->preempt_off || spin_trylock(&kernel_lock)) {
+            cpu->preempt_off = TRUE;
+            irq_restore(flags);
+            return;
+        }
+        
+        /* Spin with interrupts on so this CPU keeps serving them */
+        irq_restore(flags);
+        __asm__ volatile("pause");
+    }
+}
+
+/* Disable preemption from an interrupt handler if nobody holds the lock
+ *
+ * Fails when the kernel lock is busy, including when the interrupted task
+ * on this CPU holds it. Release with scheduler_enable_preemption().
+ */
+bool_t scheduler_try_disable_preemption(void) {
+    cpu_t *cpu;
+    bool_t taken = FALSE;
+    irq_flags_t flags;
+    
+    flags = irq_save();
+    cpu = cpu_self();
+    
+    if (!cpu->preempt_off && spin_trylock(&kernel_lock)) {
+        cpu->preempt_off = TRUE;
+        taken = TRUE;
+    }
+    
+    irq_restore(flags);
+    
+    return taken;
 }
 
-/* Enable preemption */
+/* Enable preemption, catching up on anything interrupts deferred */
 void scheduler_enable_preemption(void) {
-    preemption_enabled = TRUE;
+    cpu_t *cpu;
+    bool_t resched;
+    irq_flags_t flags;
+    
+    flags = irq_save();
+    cpu = cpu_self();
+    
+    if (cpu->preempt_off) {
+        kernel_lock_release(cpu);
+    }
+    
+    if (cpu->irq_nesting > 0 || !scheduler_running) {
+        irq_restore(flags);
+        return;
+    }
+    
+    if (defer_pending()) {
+        run_deferred(cpu);
+    }
+    
+    resched = cpu->need_resched;
+    irq_restore(flags);
+    
+    if (resched) {
+        schedule();
+    }
+}
+
+/* Enter interrupt context (first thing in an interrupt handler) */
+void scheduler_irq_enter(void) {
+    cpu_self()->irq_nesting++;
+}
+
+/* Leave interrupt context (after the EOI)
+ *
+ * Runs this CPU's deferred work with interrupts enabled, then performs at
+ * most one reschedule for the whole handler, however many tasks it woke.
+ * Both wait until the end of a task-level critical section if preemption
+ * is disabled.
+ */
+void scheduler_irq_exit(void) {
+    cpu_t *cpu = cpu_self();
+    
+    if (cpu->irq_nesting > 1) {
+        cpu->irq_nesting--;
+        return;
+    }
+    
+    /* Deferred items are task-safe code, not hard interrupt context */
+    cpu->irq_nesting = 0;
+    
+    if (!cpu->preempt_off && defer_pending()) {
+        run_deferred(cpu);
+    }
+    
+    if (!cpu->preempt_off && cpu->need_resched) {
+        schedule();
+    }
+}
+
+/* Check whether we are running in an interrupt handler */
+bool_t scheduler_in_isr(void) {
+    return cpu_self()->irq_nesting > 0;
+}
+
+/* Get the task running on this CPU */
+task_t *scheduler_get_current(void) {
+    task_t *task;
+    irq_flags_t flags;
+    
+    flags = irq_save();
+    task = cpu_self()->current;
+    irq_restore(flags);
+    
+    return task;
 }
 
 /* Get tick count */
@@ -271,6 +1243,21 @@ uint32_t scheduler_get_tick_count(void) {
     return tick_count;
 }
 
+/* Microseconds elapsed since a given tick, refined with the TSC */
+uint32_t scheduler_us_since_tick(uint32_t tick) {
+    uint32_t now;
+    uint32_t stamp;
+    
+    /* Re-read if a tick lands between the two loads */
+    do {
+        now = tick_count;
+        stamp = tick_tsc;
+    } while (now != tick_count);
+    
+    return (now - tick) * (1000000 / TIMER_FREQ_HZ) +
+           tsc_to_us(tsc_read32() - stamp);
+}
+
 /* Get task count */
 uint32_t scheduler_get_task_count(void) {
     return task_count;
@@ -0,0 +1,143 @@
+#include "../include/smp.h"
+#include "../include/apic.h"
+#include "../include/scheduler.h"
+#include "../include/memory.h"
+#include "../include/tsc.h"
+#include "../include/io.h"
+
+/* External assembly symbols */
+extern void load_idt(void);
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+
+/* Boot stacks for the APs, handed out by the trampoline (AP n gets the
+ * top of slot n - 1) */
+uint8_t ap_stacks[MAX_CPUS - 1][AP_STACK_SIZE] __attribute__((aligned(16)));
+const uint32_t ap_stack_size = AP_STACK_SIZE;
+const uint32_t ap_cpu_limit = MAX_CPUS;
+
+static cpu_t cpus[MAX_CPUS];
+static cpu_t *apic_to_cpu[256];
+static volatile uint32_t cpu_count = 1;
+static volatile bool_t smp_active = FALSE;
+
+/* Idle loop for an application processor */
+static void ap_idle_task(void *arg) {
+    while (1) {
+        __asm__ volatile("hlt");
+    }
+}
+
+/* Get the CPU we are running on (call with interrupts disabled) */
+cpu_t *cpu_self(void) {
+    cpu_t *cpu;
+    
+    if (!smp_active) {
+        return &cpus[0];
+    }
+    
+    cpu = apic_to_cpu[apic_id() & 0xFF];
+    
+    return cpu ? cpu : &cpus[0];
+}
+
+/* Get a CPU by logical number */
+cpu_t *cpu_get(uint32_t id) {
+    return &cpus[id < MAX_CPUS ? id : 0];
+}
+
+/* Get the number of CPUs brought up */
+uint32_t smp_cpu_count(void) {
+    return cpu_count;
+}
+
+/* Start the application processors (after the scheduler is initialized)
+ *
+ * Every AP is woken with a broadcast INIT-SIPI-SIPI and parks in
+ * scheduler_start_ap() until the boot CPU starts scheduling.
+ */
+void smp_init(void) {
+    cpu_t *bsp = &cpus[0];
+    task_t *idle;
+    uint32_t size;
+    uint32_t i;
+    
+    for (i = 0; i < MAX_CPUS; i++) {
+        cpus[i].id = i;
+    }
+    
+    if (MAX_CPUS < 2 || !apic_init()) {
+        return;
+    }
+    
+    bsp->apic_id = apic_id();
+    apic_to_cpu[bsp->apic_id & 0xFF] = bsp;
+    smp_active = TRUE;
+    
+    /* The trampoline runs in real mode, so it must sit below 1MB */
+    size = (uint32_t)(ap_trampoline_end - ap_trampoline_start);
+    memcpy((void *)AP_TRAMPOLINE_ADDR, ap_trampoline_start, size);
+    
+    apic_start_aps(AP_TRAMPOLINE_ADDR >> 12);
+    
+    /* Give every AP time to report in */
+    tsc_delay_us(100000);
+    
+    /* Each AP gets an idle task pinned to it */
+    for (i = 1; i < MAX_CPUS; i++) {
+        if (!cpus[i].online) {
+            continue;
+        }
+        
+        if (task_create(&idle, "idle", ap_idle_task, NULL, PRIORITY_IDLE, 0) != SUCCESS) {
+            printf("ERROR: Failed to create idle task for CPU %u!\n", i);
+            continue;
+        }
+        scheduler_set_idle(&cpus[i], idle);
+    }
+}
+
+/* C entry point of an application processor (on its boot stack) */
+void smp_ap_main(uint32_t id) {
+    cpu_t *cpu = &cpus[id];
+    uint32_t seen;
+    
+    /* Register first: everything below looks itself up by APIC ID */
+    cpu->apic_id = apic_id();
+    apic_to_cpu[cpu->apic_id & 0xFF] = cpu;
+    
+    load_idt();
+    apic_init_ap();
+    
+    /* APs report in any order; the count covers the highest number seen */
+    do {
+        seen = cpu_count;
+    } while (seen < id + 1 && atomic_cmpxchg(&cpu_count, seen, id + 1) != seen);
+    
+    cpu->online = TRUE;
+    
+    apic_timer_start();
+    
+    /* Interrupts stay off until we are about to pick a task */
+    scheduler_start_ap();
+    
+    /* Not reached: the boot stack is abandoned by the first switch */
+    while (1) {
+        __asm__ volatile("hlt");
+    }
+}
+
+/* Interrupt another CPU so it reschedules */
+void smp_send_resched(cpu_t *cpu) {
+    if (!smp_active || !cpu->online) {
+        return;
+    }
+    
+    apic_send_ipi(cpu->apic_id, IPI_RESCHED_VECTOR);
+}
+
+/* Reschedule IPI handler (interrupt context) */
+void smp_resched_interrupt(void) {
+    cpu_self()->ipis++;
+    apic_eoi();
+}
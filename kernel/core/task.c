@@ -1,28 +1,195 @@
 #include "../include/task.h"
 #include "../include/memory.h"
 #include "../include/scheduler.h"
+#include "../include/mutex.h"
+#include "../include/waitq.h"
+#include "../include/atomic.h"
+#include "../include/spinlock.h"
+#include "../include/tsc.h"
+#include "../include/reserve.h"
 #include "../include/io.h"
 
-static uint32_t next_task_id = 1;
-static task_t *current_task = NULL;
+static volatile uint32_t next_task_id = 1;
+
+/* Periodic and EDF tasks, for statistics */
+static task_t *periodic_tasks = NULL;
+static spinlock_t periodic_lock;
+
+/* Tasks blocked in task_join(), each waiting on its wait_obj (zeroed: an
+ * empty FIFO queue) */
+static wait_queue_t join_waiters;
+
+/* Fair-share tasks, for statistics */
+static task_t *fair_tasks = NULL;
+static spinlock_t fair_lock;
+
+/* Tick comparison that survives counter wrap-around */
+#define TICK_BEFORE(a, b)       ((int32_t)((a) - (b)) < 0)
+
+/* Fold a sample into a running mean over n samples (n counts it) */
+static uint32_t task_mean(uint32_t mean, uint32_t sample, uint32_t n) {
+    return mean + (uint32_t)((int32_t)(sample - mean) / (int32_t)n);
+}
+
+/* Account the start of a job: release jitter, and the start timestamp */
+static void task_job_begin(task_t *task) {
+    periodic_stats_t *stats = &task->periodic;
+    uint32_t jitter = scheduler_us_since_tick(task->release);
+    
+    task->job_start = tsc_read32();
+    
+    if (stats->jobs == 0 || jitter < stats->jitter_min) {
+        stats->jitter_min = jitter;
+    }
+    if (jitter > stats->jitter_max) {
+        stats->jitter_max = jitter;
+    }
+    stats->jobs++;
+    stats->jitter_avg = task_mean(stats->jitter_avg, jitter, stats->jobs);
+}
+
+/* Account the end of a job; returns FALSE if it ran into the next release */
+static bool_t task_job_end(task_t *task, uint32_t now) {
+    periodic_stats_t *stats = &task->periodic;
+    uint32_t exec = tsc_to_us(tsc_read32() - task->job_start);
+    bool_t on_time;
+    
+    if (stats->completed == 0 || exec < stats->exec_min) {
+        stats->exec_min = exec;
+    }
+    if (exec > stats->exec_max) {
+        stats->exec_max = exec;
+    }
+    stats->completed++;
+    stats->exec_avg = task_mean(stats->exec_avg, exec, stats->completed);
+    
+    on_time = TICK_BEFORE(now, task->release + task->period);
+    if (!on_time) {
+        stats->overruns++;
+    }
+    
+    return on_time;
+}
+
+/* Advance to the next release and sleep until it
+ *
+ * Releases stay on the original grid (release += period), so a late job
+ * never shifts later ones; if the next release has already passed, the
+ * next job starts at once.
+ */
+static void task_next_release(task_t *task, uint32_t now) {
+    task->release += task->period;
+    
+    if (TICK_BEFORE(now, task->release)) {
+        task->wake_time = task->release;
+        scheduler_block_task(task);
+        schedule();
+    } else {
+        task_yield();
+    }
+    
+    task_job_begin(task);
+}
+
+/* Put a task on the periodic statistics list */
+static void task_register_periodic(task_t *task) {
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&periodic_lock);
+    task->next_periodic = periodic_tasks;
+    periodic_tasks = task;
+    spin_unlock_irqrestore(&periodic_lock, flags);
+}
+
+/* Take a task off the periodic statistics list */
+static void task_unregister_periodic(task_t *task) {
+    task_t **link;
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&periodic_lock);
+    for (link = &periodic_tasks; *link; link = &(*link)->next_periodic) {
+        if (*link == task) {
+            *link = task->next_periodic;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&periodic_lock, flags);
+}
+
+/* Put a task on the fair-share statistics list */
+static void task_register_fair(task_t *task) {
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&fair_lock);
+    task->next_fair = fair_tasks;
+    fair_tasks = task;
+    spin_unlock_irqrestore(&fair_lock, flags);
+}
+
+/* Take a task off the fair-share statistics list */
+static void task_unregister_fair(task_t *task) {
+    task_t **link;
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&fair_lock);
+    for (link = &fair_tasks; *link; link = &(*link)->next_fair) {
+        if (*link == task) {
+            *link = task->next_fair;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&fair_lock, flags);
+}
+
+/* Match the joiners of an exiting task, handing them its exit code */
+static bool_t join_match(wait_node_t *node, void *arg) {
+    task_t *task = (task_t *)arg;
+    
+    if (node->task->wait_obj != task) {
+        return FALSE;
+    }
+    
+    node->task->wait_value = (uint32_t)task->exit_code;
+    
+    return TRUE;
+}
+
+/* Wake every task joining task (preemption disabled) */
+static void task_release_joiners(task_t *task, int32_t code) {
+    task->exit_code = code;
+    if (!waitq_empty(&join_waiters)) {
+        waitq_wake_if(&join_waiters, join_match, task);
+    }
+}
 
 /* Task wrapper function that calls the actual task and handles exit */
 static void task_wrapper(task_func_t func, void *arg) {
+    /* Entered from a context switch with its CPU still locked */
+    scheduler_task_start();
+    
+    if (task_get_current()->period) {
+        task_job_begin(task_get_current());
+    }
+    
     func(arg);
-    task_exit();
+    task_exit(0);
 }
 
-/* Create a new task */
-int32_t task_create(task_t **task, const char *name, task_func_t func, 
-                    void *arg, uint8_t priority, uint32_t stack_size) {
+/* Convert milliseconds to ticks (at least one) */
+static uint32_t task_ms_to_ticks(uint32_t ms) {
+    uint32_t ticks = (ms * TIMER_FREQ_HZ) / 1000;
+    
+    return ticks ? ticks : 1;
+}
+
+/* Allocate and initialize a task without making it runnable */
+static task_t *task_setup(const char *name, task_func_t func, void *arg,
+                          uint8_t priority, uint32_t stack_size) {
     task_t *new_task;
+    task_t *current;
     uint32_t *stack;
     uint32_t i;
     
-    if (!task || !name || !func || priority > MAX_PRIORITY) {
-        return ERROR;
-    }
-    
     if (stack_size == 0) {
         stack_size = TASK_STACK_SIZE;
     }
@@ -30,18 +197,18 @@ int32_t task_create(task_t **task, const char *name, task_func_t func,
     /* Allocate task control block */
     new_task = (task_t *)kmalloc(sizeof(task_t));
     if (!new_task) {
-        return ERROR;
+        return NULL;
     }
     
     /* Allocate stack */
     stack = (uint32_t *)kmalloc(stack_size);
     if (!stack) {
         kfree(new_task);
-        return ERROR;
+        return NULL;
     }
     
     /* Initialize task control block */
-    new_task->task_id = next_task_id++;
+    new_task->task_id = atomic_fetch_add(&next_task_id, 1);
     for (i = 0; i < TASK_NAME_LEN - 1 && name[i]; i++) {
         new_task->name[i] = name[i];
     }
@@ -49,6 +216,7 @@ int32_t task_create(task_t **task, const char *name, task_func_t func,
     
     new_task->state = TASK_READY;
     new_task->priority = priority;
+    new_task->base_priority = priority;
     new_task->time_slice = TIME_SLICE_MS;
     
     new_task->stack_base = stack;
@@ -58,6 +226,57 @@ int32_t task_create(task_t **task, const char *name, task_func_t func,
     new_task->prev = NULL;
     new_task->wake_time = 0;
     new_task->wait_obj = NULL;
+    new_task->wait_node.task = new_task;
+    new_task->wait_node.next = NULL;
+    new_task->wait_node.prev = NULL;
+    new_task->wait_node.queue = NULL;
+    new_task->wait_node.level = 0;
+    new_task->wait_node.mask = 0;
+    new_task->wait_node.options = 0;
+    new_task->wait_multi = NULL;
+    new_task->wait_multi_count = 0;
+    new_task->wait_fired = NULL;
+    new_task->wait_pending = FALSE;
+    new_task->wait_result = SUCCESS;
+    new_task->wait_value = 0;
+    new_task->notify_value = 0;
+    new_task->notify_pending = FALSE;
+    new_task->notify_waiting = FALSE;
+    new_task->ipc_request = NULL;
+    new_task->ipc_server = NULL;
+    new_task->suspended = FALSE;
+    new_task->exit_code = 0;
+    new_task->held_mutexes = NULL;
+    new_task->wait_mutex = NULL;
+    
+    /* Start out on the creating CPU; the scheduler may move it */
+    current = task_get_current();
+    new_task->cpu = current ? current->cpu : 0;
+    new_task->affinity = TASK_AFFINITY_ALL;
+    new_task->on_cpu = FALSE;
+    
+    new_task->period = 0;
+    new_task->release = 0;
+    new_task->job_start = 0;
+    task_reset_periodic_stats(new_task);
+    new_task->next_periodic = NULL;
+    
+    new_task->sched_class = SCHED_FIXED;
+    new_task->edf_budget = 0;
+    new_task->edf_deadline = 0;
+    new_task->edf_util = 0;
+    new_task->abs_deadline = 0;
+    new_task->deadline_missed = FALSE;
+    new_task->deadline_misses = 0;
+    
+    new_task->fair_weight = FAIR_WEIGHT_DEFAULT;
+    new_task->vruntime = 0;
+    new_task->fair_sleep = 0;
+    new_task->fair_ticks = 0;
+    new_task->next_fair = NULL;
+    
+    new_task->reserve = NULL;
+    new_task->next_reserved = NULL;
     
     /* Setup initial stack frame for context switching */
     stack = (uint32_t *)((uint32_t)stack + stack_size);
@@ -67,7 +286,7 @@ int32_t task_create(task_t **task, const char *name, task_func_t func,
     *(--stack) = (uint32_t)func;             /* Function pointer */
     *(--stack) = 0;                          /* Return address (unused) */
     *(--stack) = (uint32_t)task_wrapper;     /* EIP - task wrapper */
-    *(--stack) = 0x00000202;                 /* EFLAGS - IF set */
+    *(--stack) = 0x00000002;                 /* EFLAGS - IF clear */
     *(--stack) = 0;                          /* EAX */
     *(--stack) = 0;                          /* EBX */
     *(--stack) = 0;                          /* ECX */
@@ -79,7 +298,7 @@ int32_t task_create(task_t **task, const char *name, task_func_t func,
     /* Initialize CPU context */
     new_task->context.esp = (uint32_t)stack;
     new_task->context.eip = (uint32_t)task_wrapper;
-    new_task->context.eflags = 0x00000202;   /* IF set */
+    new_task->context.eflags = 0x00000002;   /* IF clear until scheduler_task_start() */
     new_task->context.cs = 0x08;             /* Kernel code segment */
     new_task->context.ss = 0x10;             /* Kernel data segment */
     new_task->context.ds = 0x10;
@@ -87,6 +306,23 @@ int32_t task_create(task_t **task, const char *name, task_func_t func,
     new_task->context.fs = 0x10;
     new_task->context.gs = 0x10;
     
+    return new_task;
+}
+
+/* Create a new task */
+int32_t task_create(task_t **task, const char *name, task_func_t func, 
+                    void *arg, uint8_t priority, uint32_t stack_size) {
+    task_t *new_task;
+    
+    if (!task || !name || !func || priority > MAX_PRIORITY) {
+        return ERROR;
+    }
+    
+    new_task = task_setup(name, func, arg, priority, stack_size);
+    if (!new_task) {
+        return ERROR;
+    }
+    
     *task = new_task;
     
     /* Add task to scheduler */
@@ -95,6 +331,92 @@ int32_t task_create(task_t **task, const char *name, task_func_t func,
     return SUCCESS;
 }
 
+/* Create an earliest-deadline-first task
+ *
+ * The first job is released now. The task is admitted only if its density
+ * budget / min(deadline, period) fits on some CPU next to the EDF tasks
+ * already there; it then stays on that CPU.
+ */
+int32_t task_create_edf(task_t **task, const char *name, task_func_t func,
+                        void *arg, uint32_t period_ms, uint32_t budget_ms,
+                        uint32_t deadline_ms, uint32_t stack_size) {
+    task_t *new_task;
+    uint32_t window;
+    uint32_t util;
+    
+    if (deadline_ms == 0) {
+        deadline_ms = period_ms;
+    }
+    
+    if (!task || !name || !func || period_ms == 0 || budget_ms == 0 ||
+        budget_ms > deadline_ms) {
+        return ERROR;
+    }
+    
+    new_task = task_setup(name, func, arg, EDF_PRIORITY, stack_size);
+    if (!new_task) {
+        return ERROR;
+    }
+    
+    new_task->sched_class = SCHED_EDF;
+    new_task->period = task_ms_to_ticks(period_ms);
+    new_task->edf_budget = task_ms_to_ticks(budget_ms);
+    new_task->edf_deadline = task_ms_to_ticks(deadline_ms);
+    
+    /* Constrained deadlines are tested by density, a sufficient bound.
+     * Measured in the ticks the task actually runs with (the conversion
+     * truncates and never gives 0) and rounded up, so admission never
+     * under-counts. */
+    window = (new_task->edf_deadline < new_task->period) ?
+             new_task->edf_deadline : new_task->period;
+    util = (new_task->edf_budget * EDF_UTIL_SCALE + window - 1) / window;
+    if (scheduler_admit_edf(new_task, util) != SUCCESS) {
+        kfree(new_task->stack_base);
+        kfree(new_task);
+        return ERROR;
+    }
+    
+    new_task->release = scheduler_get_tick_count();
+    new_task->abs_deadline = new_task->release + new_task->edf_deadline;
+    
+    *task = new_task;
+    
+    task_register_periodic(new_task);
+    scheduler_add_task(new_task);
+    
+    return SUCCESS;
+}
+
+/* Create a fixed-priority task released every period_ms
+ *
+ * The first job is released now; the task ends each job with
+ * task_wait_next_period().
+ */
+int32_t task_create_periodic(task_t **task, const char *name, task_func_t func,
+                             void *arg, uint8_t priority, uint32_t period_ms,
+                             uint32_t stack_size) {
+    task_t *new_task;
+    
+    if (!task || !name || !func || priority > MAX_PRIORITY || period_ms == 0) {
+        return ERROR;
+    }
+    
+    new_task = task_setup(name, func, arg, priority, stack_size);
+    if (!new_task) {
+        return ERROR;
+    }
+    
+    new_task->period = task_ms_to_ticks(period_ms);
+    new_task->release = scheduler_get_tick_count();
+    
+    *task = new_task;
+    
+    task_register_periodic(new_task);
+    scheduler_add_task(new_task);
+    
+    return SUCCESS;
+}
+
 /* Destroy a task */
 void task_destroy(task_t *task) {
     if (!task) {
@@ -103,6 +425,23 @@ void task_destroy(task_t *task) {
     
     scheduler_remove_task(task);
     
+    /* Joiners of a task that never exited see it end with ERROR */
+    scheduler_disable_preemption();
+    task_release_joiners(task, ERROR);
+    scheduler_enable_preemption();
+    
+    if (task->reserve) {
+        reserve_detach(task);
+    }
+    
+    if (task->period) {
+        task_unregister_periodic(task);
+    }
+    
+    if (task->sched_class == SCHED_FAIR) {
+        task_unregister_fair(task);
+    }
+    
     if (task->stack_base) {
         kfree(task->stack_base);
     }
@@ -125,11 +464,123 @@ void task_sleep(uint32_t ms) {
     }
 }
 
-/* Exit current task */
-void task_exit(void) {
+/* Finish the current periodic job and sleep until the next release
+ *
+ * Returns ERROR if the job overran into the next release (the next job
+ * then starts at once), SUCCESS otherwise.
+ */
+int32_t task_wait_next_period(void) {
     task_t *task = task_get_current();
+    uint32_t now;
+    bool_t on_time;
+    
+    if (!task || !task->period) {
+        return ERROR;
+    }
+    
+    now = scheduler_get_tick_count();
+    on_time = task_job_end(task, now);
+    
+    if (task->sched_class == SCHED_EDF) {
+        if (!task->deadline_missed && TICK_BEFORE(task->abs_deadline, now)) {
+            task->deadline_misses++;
+        }
+        task->abs_deadline = task->release + task->period + task->edf_deadline;
+        task->deadline_missed = FALSE;
+    }
+    
+    task_next_release(task, now);
+    
+    return on_time ? SUCCESS : ERROR;
+}
+
+/* Finish the current EDF job and sleep until the next release
+ *
+ * A job finishing past its absolute deadline counts as a miss.
+ */
+void task_edf_wait_next(void) {
+    task_t *task = task_get_current();
+    
+    if (task && task->sched_class == SCHED_EDF) {
+        task_wait_next_period();
+    }
+}
+
+/* Copy the index-th periodic task's statistics (ERROR past the end)
+ *
+ * Copied under periodic_lock, so a task being destroyed is either seen
+ * whole or not at all.
+ */
+int32_t task_get_periodic_info(uint32_t index, periodic_info_t *info) {
+    task_t *task;
+    uint32_t i;
+    irq_flags_t flags;
+    
+    if (!info) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&periodic_lock);
+    
+    task = periodic_tasks;
+    for (i = 0; task && i < index; i++) {
+        task = task->next_periodic;
+    }
+    
     if (task) {
+        for (i = 0; i < TASK_NAME_LEN; i++) {
+            info->name[i] = task->name[i];
+        }
+        info->period = task->period;
+        info->sched_class = task->sched_class;
+        info->deadline_misses = task->deadline_misses;
+        info->stats = task->periodic;
+    }
+    
+    spin_unlock_irqrestore(&periodic_lock, flags);
+    
+    return task ? SUCCESS : ERROR;
+}
+
+/* Clear one task's job statistics */
+static void task_clear_periodic_stats(task_t *task) {
+    periodic_stats_t *stats = &task->periodic;
+    
+    stats->jobs = 0;
+    stats->jitter_min = 0;
+    stats->jitter_max = 0;
+    stats->jitter_avg = 0;
+    stats->exec_min = 0;
+    stats->exec_max = 0;
+    stats->exec_avg = 0;
+    stats->completed = 0;
+    stats->overruns = 0;
+}
+
+/* Clear a periodic task's statistics (NULL = every periodic task) */
+void task_reset_periodic_stats(task_t *task) {
+    irq_flags_t flags;
+    
+    if (task) {
+        task_clear_periodic_stats(task);
+        return;
+    }
+    
+    flags = spin_lock_irqsave(&periodic_lock);
+    for (task = periodic_tasks; task; task = task->next_periodic) {
+        task_clear_periodic_stats(task);
+    }
+    spin_unlock_irqrestore(&periodic_lock, flags);
+}
+
+/* Exit current task, handing code to any task_join() callers */
+void task_exit(int32_t code) {
+    task_t *task = task_get_current();
+    if (task) {
+        scheduler_disable_preemption();
         task->state = TASK_TERMINATED;
+        task_release_joiners(task, code);
+        scheduler_enable_preemption();
         schedule();
     }
     
@@ -137,22 +588,114 @@ void task_exit(void) {
     while(1);
 }
 
+/* Wait for a task to exit (0 = forever) and collect its exit code
+ *
+ * The task stays allocated after it exits; task_destroy() it once joined
+ * to reclaim its stack and TCB.
+ */
+int32_t task_join(task_t *task, int32_t *code, uint32_t timeout_ms) {
+    task_t *current = task_get_current();
+    int32_t exit_code;
+    
+    if (!task || task == current) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    if (task->state == TASK_TERMINATED) {
+        exit_code = task->exit_code;
+        scheduler_enable_preemption();
+    } else {
+        if (waitq_block(&join_waiters, task, timeout_ms) != SUCCESS) {
+            return ERROR;
+        }
+        exit_code = (int32_t)current->wait_value;
+    }
+    
+    if (code) {
+        *code = exit_code;
+    }
+    
+    return SUCCESS;
+}
+
+/* Stop a task from running until task_resume() (NULL = current task) */
+int32_t task_suspend(task_t *task) {
+    return scheduler_suspend_task(task ? task : task_get_current());
+}
+
+/* Let a suspended task run again */
+int32_t task_resume(task_t *task) {
+    return scheduler_resume_task(task);
+}
+
 /* Get current running task */
 task_t *task_get_current(void) {
-    return current_task;
+    return scheduler_get_current();
+}
+
+/* Set task priority (any inherited boost stays in effect) */
+int32_t task_set_priority(task_t *task, uint8_t priority) {
+    /* EDF and fair tasks are ordered at a fixed level */
+    if (!task || priority > MAX_PRIORITY || task->sched_class != SCHED_FIXED) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    task->base_priority = priority;
+    mutex_update_priority(task);
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
 }
 
-/* Set current task (called by scheduler) */
-void task_set_current(task_t *task) {
-    current_task = task;
+/* Create a weighted fair-share task
+ *
+ * Fair tasks share level FAIR_PRIORITY in proportion to their weights
+ * (0 = FAIR_WEIGHT_DEFAULT).
+ */
+int32_t task_create_fair(task_t **task, const char *name, task_func_t func,
+                         void *arg, uint32_t weight, uint32_t stack_size) {
+    task_t *new_task;
+    
+    if (weight == 0) {
+        weight = FAIR_WEIGHT_DEFAULT;
+    }
+    
+    if (!task || !name || !func || weight > FAIR_WEIGHT_MAX) {
+        return ERROR;
+    }
+    
+    new_task = task_setup(name, func, arg, FAIR_PRIORITY, stack_size);
+    if (!new_task) {
+        return ERROR;
+    }
+    
+    new_task->sched_class = SCHED_FAIR;
+    new_task->fair_weight = weight;
+    
+    *task = new_task;
+    
+    task_register_fair(new_task);
+    scheduler_add_task(new_task);
+    
+    return SUCCESS;
 }
 
-/* Set task priority */
-int32_t task_set_priority(task_t *task, uint8_t priority) {
-    if (!task || priority > MAX_PRIORITY) {
+/* Change a fair task's weight (takes effect from the next tick) */
+int32_t task_set_weight(task_t *task, uint32_t weight) {
+    if (!task || task->sched_class != SCHED_FAIR || weight == 0 ||
+        weight > FAIR_WEIGHT_MAX) {
         return ERROR;
     }
     
-    task->priority = priority;
+    task->fair_weight = weight;
+    
     return SUCCESS;
 }
+
+/* Get the first fair-share task (follow next_fair for the rest) */
+task_t *task_get_fair(void) {
+    return fair_tasks;
+}
@@ -0,0 +1,243 @@
+#include "../include/timer.h"
+#include "../include/defer.h"
+#include "../include/irq.h"
+#include "../include/spinlock.h"
+#include "../include/memory.h"
+#include "../include/scheduler.h"
+#include "../include/config.h"
+
+/* Active timers, earliest expiry first (timer_lock to modify) */
+static timer_t *active_head = NULL;
+static spinlock_t timer_lock;
+static isr_defer_t timer_work;
+
+/* Tick comparison that survives counter wrap-around */
+#define TICK_REACHED(now, t)    ((int32_t)((now) - (t)) >= 0)
+
+/* Convert a period to ticks (at least one) */
+static uint32_t timer_ms_to_ticks(uint32_t ms) {
+    uint32_t ticks = (ms * TIMER_FREQ_HZ) / 1000;
+    
+    return ticks ? ticks : 1;
+}
+
+/* Insert in expiry order, after timers due at the same tick */
+static void timer_insert(timer_t *timer) {
+    timer_t *prev = NULL;
+    timer_t *cur = active_head;
+    
+    while (cur && TICK_REACHED(timer->expiry, cur->expiry)) {
+        prev = cur;
+        cur = cur->next;
+    }
+    
+    timer->prev = prev;
+    timer->next = cur;
+    if (cur) {
+        cur->prev = timer;
+    }
+    if (prev) {
+        prev->next = timer;
+    } else {
+        active_head = timer;
+    }
+    timer->active = TRUE;
+}
+
+/* Unlink from the active list */
+static void timer_unlink(timer_t *timer) {
+    if (!timer->active) {
+        return;
+    }
+    
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        active_head = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->active = FALSE;
+}
+
+/* Fire every expired timer (deferred work in the worker task) */
+static void timer_service(void *arg) {
+    timer_t *timer;
+    irq_flags_t flags;
+    uint32_t now = scheduler_get_tick_count();
+    
+    for (;;) {
+        flags = spin_lock_irqsave(&timer_lock);
+        
+        timer = active_head;
+        if (!timer || !TICK_REACHED(now, timer->expiry)) {
+            spin_unlock_irqrestore(&timer_lock, flags);
+            break;
+        }
+        
+        timer_unlink(timer);
+        
+        /* Re-arm before the callback so it may stop or delete itself */
+        if (timer->mode == TIMER_AUTO_RELOAD) {
+            timer->expiry += timer->period;
+            if (TICK_REACHED(now, timer->expiry)) {
+                /* Overran by a whole period: skip ahead rather than burst */
+                timer->expiry = now + timer->period;
+            }
+            timer_insert(timer);
+        }
+        
+        /* Pinned until the callback returns; timer_delete() leaves the
+         * free to us meanwhile */
+        timer->running = TRUE;
+        spin_unlock_irqrestore(&timer_lock, flags);
+        
+        timer->func(timer, timer->arg);
+        
+        flags = spin_lock_irqsave(&timer_lock);
+        timer->running = FALSE;
+        if (!timer->valid) {
+            spin_unlock_irqrestore(&timer_lock, flags);
+            kfree(timer);
+            continue;
+        }
+        spin_unlock_irqrestore(&timer_lock, flags);
+    }
+}
+
+/* Set up the timer service */
+void timer_init(void) {
+    active_head = NULL;
+    spin_init(&timer_lock);
+    defer_item_init(&timer_work, "timers", timer_service, NULL, DEFER_THREAD);
+}
+
+/* Queue the service if the earliest timer is due (timer interrupt) */
+void timer_tick_from_isr(uint32_t now) {
+    bool_t due;
+    
+    spin_lock(&timer_lock);
+    due = active_head && TICK_REACHED(now, active_head->expiry);
+    spin_unlock(&timer_lock);
+    
+    if (due) {
+        defer_queue_from_isr(&timer_work);
+    }
+}
+
+/* Create a stopped timer */
+int32_t timer_create(timer_t **timer, timer_func_t func, void *arg,
+                     uint32_t period_ms, uint32_t mode) {
+    timer_t *t;
+    
+    if (!timer || !func || period_ms == 0 || mode > TIMER_AUTO_RELOAD) {
+        return ERROR;
+    }
+    
+    t = (timer_t *)kmalloc(sizeof(timer_t));
+    if (!t) {
+        return ERROR;
+    }
+    
+    t->func = func;
+    t->arg = arg;
+    t->period = timer_ms_to_ticks(period_ms);
+    t->expiry = 0;
+    t->mode = mode;
+    t->next = NULL;
+    t->prev = NULL;
+    t->active = FALSE;
+    t->running = FALSE;
+    t->valid = TRUE;
+    
+    *timer = t;
+    
+    return SUCCESS;
+}
+
+/* Start (or restart) a timer one period from now */
+int32_t timer_start(timer_t *timer) {
+    irq_flags_t flags;
+    
+    if (!timer || !timer->valid) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&timer_lock);
+    timer_unlink(timer);
+    timer->expiry = scheduler_get_tick_count() + timer->period;
+    timer_insert(timer);
+    spin_unlock_irqrestore(&timer_lock, flags);
+    
+    return SUCCESS;
+}
+
+/* Stop a timer */
+int32_t timer_stop(timer_t *timer) {
+    irq_flags_t flags;
+    
+    if (!timer || !timer->valid) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&timer_lock);
+    timer_unlink(timer);
+    spin_unlock_irqrestore(&timer_lock, flags);
+    
+    return SUCCESS;
+}
+
+/* Change the period; an active timer restarts with the new period */
+int32_t timer_change_period(timer_t *timer, uint32_t period_ms) {
+    irq_flags_t flags;
+    
+    if (!timer || !timer->valid || period_ms == 0) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&timer_lock);
+    timer->period = timer_ms_to_ticks(period_ms);
+    if (timer->active) {
+        timer_unlink(timer);
+        timer->expiry = scheduler_get_tick_count() + timer->period;
+        timer_insert(timer);
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+    
+    return SUCCESS;
+}
+
+/* Stop and free a timer
+ *
+ * If its callback is running (on another CPU, or this is the callback
+ * deleting its own timer), the service frees it once the callback returns.
+ */
+int32_t timer_delete(timer_t *timer) {
+    bool_t running;
+    irq_flags_t flags;
+    
+    if (!timer || !timer->valid) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&timer_lock);
+    timer_unlink(timer);
+    timer->valid = FALSE;
+    running = timer->running;
+    spin_unlock_irqrestore(&timer_lock, flags);
+    
+    if (!running) {
+        kfree(timer);
+    }
+    
+    return SUCCESS;
+}
+
+/* Check whether a timer is running */
+bool_t timer_is_active(timer_t *timer) {
+    return timer && timer->valid && timer->active;
+}
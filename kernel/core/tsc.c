@@ -0,0 +1,61 @@
+#include "../include/tsc.h"
+
+#define PIT_INPUT_HZ        1193182
+#define TSC_CAL_MS          10      /* Calibration window */
+
+static uint32_t tsc_mhz = 0;
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile("inb %1, %0" : "=a"(value) : "d"(port));
+    return value;
+}
+
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile("outb %0, %1" : : "a"(value), "d"(port));
+}
+
+/* Measure the TSC rate against PIT channel 2 (before interrupts are on) */
+void tsc_init(void) {
+    uint32_t latch = (PIT_INPUT_HZ * TSC_CAL_MS) / 1000;
+    uint64_t start;
+    uint64_t end;
+    
+    /* Gate channel 2 on, speaker off */
+    outb(0x61, (inb(0x61) & ~0x02) | 0x01);
+    
+    /* Channel 2, lobyte/hibyte, mode 0 (one-shot) */
+    outb(0x43, 0xB0);
+    outb(0x42, latch & 0xFF);
+    outb(0x42, (latch >> 8) & 0xFF);
+    
+    start = tsc_read();
+    while (!(inb(0x61) & 0x20)) {
+        /* Wait for terminal count */
+    }
+    end = tsc_read();
+    
+    tsc_mhz = (uint32_t)(end - start) / (TSC_CAL_MS * 1000);
+    if (tsc_mhz == 0) {
+        tsc_mhz = 1;
+    }
+}
+
+/* Get the calibrated TSC frequency in MHz */
+uint32_t tsc_get_mhz(void) {
+    return tsc_mhz;
+}
+
+/* Convert a cycle count to microseconds */
+uint32_t tsc_to_us(uint32_t cycles) {
+    return tsc_mhz ? cycles / tsc_mhz : 0;
+}
+
+/* Busy-wait for a number of microseconds */
+void tsc_delay_us(uint32_t us) {
+    uint64_t end = tsc_read() + (uint64_t)us * tsc_mhz;
+    
+    while (tsc_read() < end) {
+        __asm__ volatile("pause");
+    }
+}
@@ -0,0 +1,282 @@
+#include "../include/actor.h"
+#include "../include/semaphore.h"
+#include "../include/task.h"
+#include "../include/memory.h"
+#include "../include/io.h"
+#include "../include/config.h"
+
+/* Actors with mail, oldest first (run_lock) */
+static actor_t *run_head = NULL;
+static actor_t *run_tail = NULL;
+static spinlock_t run_lock;
+
+/* One unit per queued actor; workers sleep on it */
+static semaphore_t run_ready;
+
+static actor_stats_t actor_stats;
+
+/* Append an actor to the run queue and wake a worker */
+static void actor_enqueue(actor_t *actor, bool_t from_isr) {
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&run_lock);
+    actor->next = NULL;
+    if (run_tail) {
+        run_tail->next = actor;
+    } else {
+        run_head = actor;
+    }
+    run_tail = actor;
+    spin_unlock_irqrestore(&run_lock, flags);
+    
+    if (from_isr) {
+        sem_post_from_isr(&run_ready);
+    } else {
+        sem_post(&run_ready);
+    }
+}
+
+/* Take the oldest actor off the run queue */
+static actor_t *actor_dequeue(void) {
+    actor_t *actor;
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&run_lock);
+    actor = run_head;
+    if (actor) {
+        run_head = actor->next;
+        if (!run_head) {
+            run_tail = NULL;
+        }
+        actor->next = NULL;
+    }
+    spin_unlock_irqrestore(&run_lock, flags);
+    
+    return actor;
+}
+
+/* Queue a message; the first message of an idle actor schedules it */
+static int32_t actor_post(actor_t *actor, void *msg, bool_t from_isr) {
+    bool_t wake = FALSE;
+    irq_flags_t flags;
+    
+    if (!actor) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&actor->lock);
+    
+    if (!actor->valid || actor->count == actor->capacity) {
+        actor->dropped++;
+        spin_unlock_irqrestore(&actor->lock, flags);
+        return ERROR;
+    }
+    
+    actor->mailbox[(actor->head + actor->count) % actor->capacity] = msg;
+    actor->count++;
+    
+    if (!actor->scheduled) {
+        actor->scheduled = TRUE;
+        wake = TRUE;
+    }
+    
+    spin_unlock_irqrestore(&actor->lock, flags);
+    
+    if (wake) {
+        actor_enqueue(actor, from_isr);
+    }
+    
+    return SUCCESS;
+}
+
+/* Free an actor's memory */
+static void actor_free(actor_t *actor) {
+    kfree(actor->mailbox);
+    kfree(actor);
+}
+
+/* Deliver up to ACTOR_BATCH messages to one actor (pool worker) */
+static void actor_run(actor_t *actor) {
+    void *msg;
+    uint32_t batch = 0;
+    bool_t again;
+    bool_t dead;
+    irq_flags_t flags;
+    
+    while (batch < ACTOR_BATCH) {
+        flags = spin_lock_irqsave(&actor->lock);
+        if (!actor->valid || actor->count == 0) {
+            spin_unlock_irqrestore(&actor->lock, flags);
+            break;
+        }
+        msg = actor->mailbox[actor->head];
+        actor->head = (actor->head + 1) % actor->capacity;
+        actor->count--;
+        spin_unlock_irqrestore(&actor->lock, flags);
+        
+        actor->handler(actor, msg);
+        actor->delivered++;
+        batch++;
+    }
+    
+    /* Still busy: go to the back of the line so others get a turn */
+    flags = spin_lock_irqsave(&actor->lock);
+    dead = !actor->valid;
+    again = !dead && actor->count > 0;
+    actor->scheduled = again;
+    spin_unlock_irqrestore(&actor->lock, flags);
+    
+    flags = spin_lock_irqsave(&run_lock);
+    actor_stats.messages += batch;
+    actor_stats.batches++;
+    if (batch > actor_stats.max_batch) {
+        actor_stats.max_batch = batch;
+    }
+    spin_unlock_irqrestore(&run_lock, flags);
+    
+    if (again) {
+        actor_enqueue(actor, FALSE);
+    } else if (dead) {
+        /* Destroyed while we ran it; the destroyer left it to us */
+        actor_free(actor);
+    }
+}
+
+/* Pool worker: run actors as they become ready */
+static void actor_worker(void *arg) {
+    actor_t *actor;
+    
+    while (1) {
+        if (sem_wait(&run_ready, 0) != SUCCESS) {
+            continue;
+        }
+        
+        actor = actor_dequeue();
+        if (actor) {
+            actor_run(actor);
+        }
+    }
+}
+
+/* Set up the run queue and start the worker pool */
+void actor_init(void) {
+    task_t *worker;
+    uint32_t i;
+    
+    run_head = NULL;
+    run_tail = NULL;
+    spin_init(&run_lock);
+    sem_init(&run_ready, 0, 0xFFFFFFFF);
+    
+    actor_stats.actors = 0;
+    actor_stats.messages = 0;
+    actor_stats.batches = 0;
+    actor_stats.max_batch = 0;
+    
+    for (i = 0; i < ACTOR_WORKERS; i++) {
+        if (task_create(&worker, "actor", actor_worker, NULL,
+                        ACTOR_WORKER_PRIORITY, 0) != SUCCESS) {
+            printf("ERROR: Failed to create actor worker %u!\n", i);
+        }
+    }
+}
+
+/* Create an actor with an empty mailbox of the given size */
+int32_t actor_create(actor_t **actor, const char *name, actor_handler_t handler,
+                     void *state, uint32_t capacity) {
+    actor_t *a;
+    irq_flags_t flags;
+    
+    if (!actor || !name || !handler || capacity == 0) {
+        return ERROR;
+    }
+    
+    a = (actor_t *)kmalloc(sizeof(actor_t));
+    if (!a) {
+        return ERROR;
+    }
+    
+    a->mailbox = (void **)kmalloc(capacity * sizeof(void *));
+    if (!a->mailbox) {
+        kfree(a);
+        return ERROR;
+    }
+    
+    a->name = name;
+    a->handler = handler;
+    a->state = state;
+    a->capacity = capacity;
+    a->head = 0;
+    a->count = 0;
+    a->scheduled = FALSE;
+    a->valid = TRUE;
+    a->next = NULL;
+    spin_init(&a->lock);
+    a->delivered = 0;
+    a->dropped = 0;
+    
+    flags = spin_lock_irqsave(&run_lock);
+    actor_stats.actors++;
+    spin_unlock_irqrestore(&run_lock, flags);
+    
+    *actor = a;
+    
+    return SUCCESS;
+}
+
+/* Send a message (never blocks; ERROR if the mailbox is full) */
+int32_t actor_send(actor_t *actor, void *msg) {
+    return actor_post(actor, msg, FALSE);
+}
+
+/* Send a message from an interrupt handler */
+int32_t actor_send_from_isr(actor_t *actor, void *msg) {
+    return actor_post(actor, msg, TRUE);
+}
+
+/* Destroy an actor, dropping undelivered mail
+ *
+ * If a worker holds it, the worker frees it after the current message,
+ * so an actor may destroy itself from its handler.
+ */
+int32_t actor_destroy(actor_t *actor) {
+    bool_t busy;
+    irq_flags_t flags;
+    
+    if (!actor) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&actor->lock);
+    if (!actor->valid) {
+        spin_unlock_irqrestore(&actor->lock, flags);
+        return ERROR;
+    }
+    actor->valid = FALSE;
+    actor->count = 0;
+    busy = actor->scheduled;
+    spin_unlock_irqrestore(&actor->lock, flags);
+    
+    flags = spin_lock_irqsave(&run_lock);
+    actor_stats.actors--;
+    spin_unlock_irqrestore(&run_lock, flags);
+    
+    if (!busy) {
+        actor_free(actor);
+    }
+    
+    return SUCCESS;
+}
+
+/* Copy the runtime statistics */
+void actor_get_stats(actor_stats_t *stats) {
+    irq_flags_t flags;
+    
+    if (!stats) {
+        return;
+    }
+    
+    flags = spin_lock_irqsave(&run_lock);
+    *stats = actor_stats;
+    spin_unlock_irqrestore(&run_lock, flags);
+}
@@ -0,0 +1,159 @@
+#include "../include/cond.h"
+#include "../include/scheduler.h"
+
+/* wait_value markers telling a woken waiter how it was released */
+#define COND_WOKEN          0       /* Woken; must relock the mutex itself */
+#define COND_MORPHED        1       /* Moved to the mutex; owns it on wake-up */
+
+/* Release one waiter taken off the condition's queue */
+static void cond_release(cond_t *cond, task_t *task) {
+    mutex_t *mutex = cond->mutex;
+    
+    /* Mutex is busy and the waiter is still asleep: morph it onto the
+     * mutex queue so the unlock hands it ownership directly */
+    if (mutex && mutex->owner && task->state == TASK_BLOCKED) {
+        task->wake_time = 0;
+        task->wait_obj = mutex;
+        task->wait_value = COND_MORPHED;
+        task->wait_mutex = mutex;
+        waitq_enqueue(&mutex->waiters, task);
+        mutex_update_priority(mutex->owner);
+        return;
+    }
+    
+    task->wait_value = COND_WOKEN;
+    task->wait_obj = NULL;
+    task->wait_result = SUCCESS;
+    task->wake_time = 0;
+    scheduler_unblock_task(task);
+}
+
+/* Initialize a condition variable */
+int32_t cond_init(cond_t *cond) {
+    if (!cond) {
+        return ERROR;
+    }
+    
+    waitq_init(&cond->waiters, WAITQ_PRIORITY);
+    cond->mutex = NULL;
+    cond->valid = TRUE;
+    
+    return SUCCESS;
+}
+
+/* Wait for a signal; the mutex is released while waiting and held again
+ * on return, at the same recursion depth */
+int32_t cond_wait(cond_t *cond, mutex_t *mutex) {
+    return cond_timedwait(cond, mutex, 0);
+}
+
+/* Wait for a signal with a timeout (0 = infinite) */
+int32_t cond_timedwait(cond_t *cond, mutex_t *mutex, uint32_t timeout_ms) {
+    task_t *current;
+    uint32_t depth;
+    int32_t result;
+    bool_t owned = FALSE;
+    
+    if (!cond || !cond->valid || !mutex || !mutex->valid) {
+        return ERROR;
+    }
+    
+    current = task_get_current();
+    if (!current || mutex->owner != current) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    if (cond->mutex && cond->mutex != mutex) {
+        scheduler_enable_preemption();
+        return ERROR;
+    }
+    cond->mutex = mutex;
+    
+    /* Queue before dropping the mutex so no signal can slip past */
+    waitq_enqueue(&cond->waiters, current);
+    current->wait_obj = cond;
+    current->wait_value = COND_WOKEN;
+    
+    depth = mutex->lock_count;
+    mutex_release(mutex);
+    
+    waitq_park(timeout_ms);
+    
+    if (current->wait_pending) {
+        /* Timed out while still waiting for the signal */
+        waitq_remove(&cond->waiters, current);
+        result = ERROR;
+    } else if (current->wait_value == COND_MORPHED) {
+        /* Woken by the mutex hand-off (or the mutex was destroyed) */
+        result = current->wait_result;
+        owned = (mutex->owner == current);
+        current->wait_mutex = NULL;
+    } else {
+        result = current->wait_result;
+    }
+    current->wait_obj = NULL;
+    
+    scheduler_enable_preemption();
+    
+    if (!owned && mutex_lock(mutex, 0) != SUCCESS) {
+        return ERROR;
+    }
+    mutex->lock_count = depth;
+    
+    return result;
+}
+
+/* Release the highest-priority waiter */
+int32_t cond_signal(cond_t *cond) {
+    task_t *task;
+    
+    if (!cond || !cond->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    task = waitq_dequeue(&cond->waiters);
+    if (task) {
+        cond_release(cond, task);
+    }
+    
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
+/* Release every waiter; with the mutex held they all move to its queue */
+int32_t cond_broadcast(cond_t *cond) {
+    task_t *task;
+    
+    if (!cond || !cond->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    while ((task = waitq_dequeue(&cond->waiters)) != NULL) {
+        cond_release(cond, task);
+    }
+    
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
+/* Destroy a condition variable, failing all waiters */
+int32_t cond_destroy(cond_t *cond) {
+    if (!cond || !cond->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    cond->valid = FALSE;
+    waitq_wake_all(&cond->waiters, ERROR);
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
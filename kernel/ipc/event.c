@@ -0,0 +1,184 @@
+#include "../include/event.h"
+#include "../include/scheduler.h"
+
+/* State shared with the wake filter during event_set() */
+typedef struct {
+    uint32_t flags;             /* Flags after the set */
+    uint32_t clear;             /* Bits to clear once everyone is woken */
+} event_wake_t;
+
+/* Check whether flags satisfy a wait request */
+static bool_t event_satisfied(uint32_t flags, uint32_t bits, uint32_t options) {
+    if (options & EVENT_WAIT_ALL) {
+        return (flags & bits) == bits;
+    }
+    
+    return (flags & bits) != 0;
+}
+
+/* Wake filter: pick waiters whose condition is now met */
+static bool_t event_match(wait_node_t *node, void *arg) {
+    event_wake_t *wake = (event_wake_t *)arg;
+    
+    if (!event_satisfied(wake->flags, node->mask, node->options)) {
+        return FALSE;
+    }
+    
+    node->task->wait_value = wake->flags;
+    if (node->options & EVENT_CLEAR_ON_EXIT) {
+        wake->clear |= node->mask;
+    }
+    
+    return TRUE;
+}
+
+/* Consume a wait request without blocking (preemption disabled) */
+bool_t event_poll(event_group_t *group, uint32_t bits, uint32_t options,
+                  uint32_t *flags_out) {
+    if (!event_satisfied(group->flags, bits, options)) {
+        return FALSE;
+    }
+    
+    if (flags_out) {
+        *flags_out = group->flags;
+    }
+    if (options & EVENT_CLEAR_ON_EXIT) {
+        group->flags &= ~bits;
+    }
+    
+    return TRUE;
+}
+
+/* Initialize an event group */
+int32_t event_init(event_group_t *group) {
+    if (!group) {
+        return ERROR;
+    }
+    
+    group->flags = 0;
+    waitq_init(&group->waiters, WAITQ_PRIORITY);
+    group->valid = TRUE;
+    
+    return SUCCESS;
+}
+
+/* Set bits and wake every waiter whose condition is met, in one pass */
+uint32_t event_set(event_group_t *group, uint32_t bits) {
+    event_wake_t wake;
+    uint32_t flags;
+    
+    if (!group || !group->valid) {
+        return 0;
+    }
+    
+    scheduler_disable_preemption();
+    
+    group->flags |= bits;
+    wake.flags = group->flags;
+    wake.clear = 0;
+    
+    if (!waitq_empty(&group->waiters)) {
+        waitq_wake_if(&group->waiters, event_match, &wake);
+    }
+    
+    /* Auto-clear after the pass so every waiter saw the same flags */
+    group->flags &= ~wake.clear;
+    flags = group->flags;
+    
+    scheduler_enable_preemption();
+    
+    return flags;
+}
+
+/* Clear bits; returns the flags before clearing */
+uint32_t event_clear(event_group_t *group, uint32_t bits) {
+    uint32_t flags;
+    
+    if (!group || !group->valid) {
+        return 0;
+    }
+    
+    scheduler_disable_preemption();
+    flags = group->flags;
+    group->flags &= ~bits;
+    scheduler_enable_preemption();
+    
+    return flags;
+}
+
+/* Wait for any/all of the given bits */
+int32_t event_wait(event_group_t *group, uint32_t bits, uint32_t options,
+                   uint32_t *flags_out, uint32_t timeout_ms) {
+    task_t *current;
+    int32_t result;
+    
+    if (!group || !group->valid || bits == 0) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    if (event_poll(group, bits, options, flags_out)) {
+        scheduler_enable_preemption();
+        return SUCCESS;
+    }
+    
+    current = task_get_current();
+    if (!current) {
+        scheduler_enable_preemption();
+        return ERROR;
+    }
+    
+    current->wait_node.mask = bits;
+    current->wait_node.options = options;
+    
+    result = waitq_block(&group->waiters, group, timeout_ms);
+    
+    if (flags_out) {
+        *flags_out = (result == SUCCESS) ? current->wait_value : group->flags;
+    }
+    
+    return result;
+}
+
+/* Take a wait request only if already satisfied (never blocks) */
+int32_t event_trywait(event_group_t *group, uint32_t bits, uint32_t options,
+                      uint32_t *flags_out) {
+    bool_t satisfied;
+    
+    if (!group || !group->valid || bits == 0) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    satisfied = event_poll(group, bits, options, flags_out);
+    scheduler_enable_preemption();
+    
+    return satisfied ? SUCCESS : ERROR;
+}
+
+/* Get current flags */
+uint32_t event_get(event_group_t *group) {
+    if (!group || !group->valid) {
+        return 0;
+    }
+    
+    return group->flags;
+}
+
+/* Destroy an event group */
+int32_t event_destroy(event_group_t *group) {
+    if (!group || !group->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    /* Wake up all waiting tasks */
+    group->valid = FALSE;
+    waitq_wake_all(&group->waiters, ERROR);
+    
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
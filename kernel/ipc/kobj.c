@@ -0,0 +1,145 @@
+#include "../include/kobj.h"
+#include "../include/queue.h"
+#include "../include/event.h"
+#include "../include/scheduler.h"
+
+/* Wait queue a task joins to wait on an object */
+static wait_queue_t *kobj_waitq(kobj_wait_t *entry) {
+    switch (entry->type) {
+        case KOBJ_SEMAPHORE:
+            return &((semaphore_t *)entry->obj)->waiters;
+        case KOBJ_QUEUE:
+            return &((queue_t *)entry->obj)->not_empty.waiters;
+        case KOBJ_EVENT:
+            return &((event_group_t *)entry->obj)->waiters;
+    }
+    
+    return NULL;
+}
+
+/* Check that an entry refers to a live object */
+static bool_t kobj_valid(kobj_wait_t *entry) {
+    if (!entry->obj) {
+        return FALSE;
+    }
+    
+    switch (entry->type) {
+        case KOBJ_SEMAPHORE:
+            return ((semaphore_t *)entry->obj)->valid;
+        case KOBJ_QUEUE:
+            return ((queue_t *)entry->obj)->valid;
+        case KOBJ_EVENT:
+            return ((event_group_t *)entry->obj)->valid && entry->bits != 0;
+    }
+    
+    return FALSE;
+}
+
+/* Try to satisfy an entry without blocking (preemption disabled) */
+static bool_t kobj_poll(kobj_wait_t *entry) {
+    switch (entry->type) {
+        case KOBJ_SEMAPHORE:
+            return sem_trywait((semaphore_t *)entry->obj) == SUCCESS;
+        case KOBJ_QUEUE:
+            return sem_trywait(&((queue_t *)entry->obj)->not_empty) == SUCCESS;
+        case KOBJ_EVENT:
+            return event_poll((event_group_t *)entry->obj, entry->bits,
+                              entry->options, &entry->flags);
+    }
+    
+    return FALSE;
+}
+
+/* Finish the operation for the entry that fired */
+static int32_t kobj_complete(kobj_wait_t *entry, uint32_t timeout_ms) {
+    if (entry->type == KOBJ_QUEUE) {
+        return queue_take((queue_t *)entry->obj, &entry->msg, timeout_ms);
+    }
+    
+    return SUCCESS;
+}
+
+/* Wait on several kernel objects at once
+ *
+ * The task is queued on every object's wait queue in one go; whichever
+ * object claims it first wins, and the remaining entries are unlinked.
+ */
+int32_t kobj_wait_any(kobj_wait_t *objs, uint32_t count, uint32_t timeout_ms) {
+    wait_node_t nodes[KOBJ_WAIT_MAX];
+    task_t *current;
+    int32_t fired = ERROR;
+    int32_t result = ERROR;
+    uint32_t i;
+    
+    if (!objs || count == 0 || count > KOBJ_WAIT_MAX) {
+        return ERROR;
+    }
+    
+    for (i = 0; i < count; i++) {
+        if (!kobj_valid(&objs[i])) {
+            return ERROR;
+        }
+    }
+    
+    scheduler_disable_preemption();
+    
+    /* Something may already be available */
+    for (i = 0; i < count; i++) {
+        if (kobj_poll(&objs[i])) {
+            scheduler_enable_preemption();
+            return kobj_complete(&objs[i], timeout_ms) == SUCCESS ? (int32_t)i : ERROR;
+        }
+    }
+    
+    current = task_get_current();
+    if (!current) {
+        scheduler_enable_preemption();
+        return ERROR;
+    }
+    
+    /* Join every wait queue */
+    for (i = 0; i < count; i++) {
+        nodes[i].task = current;
+        nodes[i].mask = objs[i].bits;
+        nodes[i].options = objs[i].options;
+        waitq_add(kobj_waitq(&objs[i]), &nodes[i]);
+    }
+    current->wait_multi = nodes;
+    current->wait_multi_count = count;
+    
+    /* Re-check semaphores: a fast-path post may have raced the enqueue */
+    for (i = 0; i < count && fired == ERROR; i++) {
+        if (objs[i].type != KOBJ_EVENT && kobj_poll(&objs[i])) {
+            fired = (int32_t)i;
+            result = SUCCESS;
+        }
+    }
+    
+    if (fired == ERROR) {
+        current->wait_obj = objs;
+        waitq_park(timeout_ms);
+        current->wait_obj = NULL;
+        
+        if (current->wait_fired) {
+            fired = (int32_t)(current->wait_fired - nodes);
+            result = current->wait_result;
+        }
+    }
+    
+    /* Leave every queue we are still on */
+    waitq_cancel(current);
+    current->wait_multi = NULL;
+    current->wait_multi_count = 0;
+    
+    scheduler_enable_preemption();
+    
+    if (fired == ERROR || result != SUCCESS) {
+        return ERROR;
+    }
+    
+    if (objs[fired].type == KOBJ_EVENT && current->wait_fired) {
+        objs[fired].flags = current->wait_value;
+    }
+    
+    return kobj_complete(&objs[fired], timeout_ms) == SUCCESS ? fired : ERROR;
+}
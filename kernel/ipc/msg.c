@@ -0,0 +1,238 @@
+#include "../include/msg.h"
+#include "../include/scheduler.h"
+#include "../include/memory.h"
+
+/* Client side of a transaction (lives on the client's stack) */
+typedef struct {
+    const void *smsg;           /* Request buffer */
+    uint32_t slen;              /* Request length */
+    void *rmsg;                 /* Reply buffer */
+    uint32_t rlen;              /* Reply buffer size */
+    int32_t status;             /* Status passed to msg_reply() */
+} msg_request_t;
+
+/* Server side of a blocked receive (lives on the server's stack) */
+typedef struct {
+    void *buf;                  /* Receive buffer */
+    uint32_t len;               /* Receive buffer size */
+    uint32_t received;          /* Bytes delivered */
+    task_t *client;             /* Sender, NULL if the channel went away */
+} msg_receive_t;
+
+/* Copy a message; short ones go word by word through registers */
+static uint32_t msg_copy(void *dst, uint32_t dst_len, const void *src, uint32_t src_len) {
+    uint32_t len = (src_len < dst_len) ? src_len : dst_len;
+    uint32_t *d;
+    const uint32_t *s;
+    uint32_t i;
+    
+    if (len == 0 || !dst || !src) {
+        return 0;
+    }
+    
+    if (len <= MSG_SHORT_MAX && !(((uint32_t)dst | (uint32_t)src | len) & 3)) {
+        d = (uint32_t *)dst;
+        s = (const uint32_t *)src;
+        for (i = 0; i < len / 4; i++) {
+            d[i] = s[i];
+        }
+    } else {
+        memcpy(dst, src, len);
+    }
+    
+    return len;
+}
+
+/* Initialize a channel */
+int32_t channel_init(channel_t *chan) {
+    if (!chan) {
+        return ERROR;
+    }
+    
+    waitq_init(&chan->senders, WAITQ_PRIORITY);
+    chan->receiver = NULL;
+    chan->valid = TRUE;
+    
+    return SUCCESS;
+}
+
+/* Send a message and block until the server replies
+ *
+ * Returns the status given to msg_reply(), or ERROR if the channel is
+ * destroyed first.
+ */
+int32_t msg_send(channel_t *chan, const void *smsg, uint32_t slen,
+                 void *rmsg, uint32_t rlen) {
+    msg_request_t req;
+    msg_receive_t *rcv;
+    task_t *current;
+    task_t *server;
+    
+    if (!chan || !chan->valid) {
+        return ERROR;
+    }
+    
+    current = task_get_current();
+    if (!current) {
+        return ERROR;
+    }
+    
+    req.smsg = smsg;
+    req.slen = slen;
+    req.rmsg = rmsg;
+    req.rlen = rlen;
+    req.status = ERROR;
+    
+    scheduler_disable_preemption();
+    current->ipc_request = &req;
+    
+    server = chan->receiver;
+    if (server) {
+        /* Server is waiting: deliver and switch straight to it */
+        chan->receiver = NULL;
+        rcv = (msg_receive_t *)server->ipc_request;
+        rcv->received = msg_copy(rcv->buf, rcv->len, smsg, slen);
+        rcv->client = current;
+        current->ipc_server = server;
+        
+        /* Blocked by the hand-off itself: blocking first would let a
+         * reschedule here switch us out with the server still asleep */
+        current->wake_time = 0;
+        scheduler_enable_preemption();
+        scheduler_handoff_block(server);
+    } else {
+        /* Wait for msg_receive(); we stay blocked until the reply */
+        waitq_enqueue(&chan->senders, current);
+        current->wait_obj = chan;
+        waitq_park(0);
+        current->wait_obj = NULL;
+        if (current->wait_pending) {
+            waitq_remove(&chan->senders, current);
+        }
+        scheduler_enable_preemption();
+    }
+    
+    current->ipc_request = NULL;
+    current->ipc_server = NULL;
+    
+    return req.status;
+}
+
+/* Receive the next message on a channel
+ *
+ * Returns the number of bytes received and the client to reply to, or
+ * ERROR if the channel is destroyed while waiting.
+ */
+int32_t msg_receive(channel_t *chan, void *msg, uint32_t len, task_t **client) {
+    msg_receive_t rcv;
+    msg_request_t *req;
+    task_t *current;
+    task_t *sender;
+    
+    if (!chan || !chan->valid || !client) {
+        return ERROR;
+    }
+    
+    current = task_get_current();
+    if (!current) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    /* A client is already send-blocked: take it over, it stays blocked
+     * until we reply */
+    sender = waitq_dequeue(&chan->senders);
+    if (sender) {
+        req = (msg_request_t *)sender->ipc_request;
+        rcv.received = msg_copy(msg, len, req->smsg, req->slen);
+        sender->wait_obj = NULL;
+        sender->ipc_server = current;
+        scheduler_enable_preemption();
+        *client = sender;
+        return (int32_t)rcv.received;
+    }
+    
+    /* Only one server may wait on a channel */
+    if (chan->receiver) {
+        scheduler_enable_preemption();
+        return ERROR;
+    }
+    
+    rcv.buf = msg;
+    rcv.len = len;
+    rcv.received = 0;
+    rcv.client = NULL;
+    current->ipc_request = &rcv;
+    chan->receiver = current;
+    
+    current->wake_time = 0;
+    scheduler_block_task(current);
+    scheduler_enable_preemption();
+    schedule();
+    
+    current->ipc_request = NULL;
+    
+    if (!rcv.client) {
+        return ERROR;
+    }
+    
+    *client = rcv.client;
+    return (int32_t)rcv.received;
+}
+
+/* Reply to a received message and switch back to the client
+ *
+ * Only the server that received the client's message may reply, once.
+ */
+int32_t msg_reply(task_t *client, int32_t status, const void *msg, uint32_t len) {
+    msg_request_t *req;
+    
+    if (!client) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    /* Reply-blocked on us: anything else (a server in msg_receive(), a
+     * sender not yet received) has no request we may answer */
+    if (client->ipc_server != task_get_current() || !client->ipc_request ||
+        client->state != TASK_BLOCKED) {
+        scheduler_enable_preemption();
+        return ERROR;
+    }
+    client->ipc_server = NULL;
+    
+    req = (msg_request_t *)client->ipc_request;
+    msg_copy(req->rmsg, req->rlen, msg, len);
+    req->status = status;
+    
+    scheduler_enable_preemption();
+    scheduler_handoff(client);
+    
+    return SUCCESS;
+}
+
+/* Destroy a channel, failing all pending senders and the receiver */
+int32_t channel_destroy(channel_t *chan) {
+    task_t *server;
+    
+    if (!chan || !chan->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    chan->valid = FALSE;
+    waitq_wake_all(&chan->senders, ERROR);
+    
+    server = chan->receiver;
+    chan->receiver = NULL;
+    if (server) {
+        scheduler_unblock_task(server);
+    }
+    
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
@@ -0,0 +1,238 @@
+#include "../include/mutex.h"
+#include "../include/scheduler.h"
+
+/* Add mutex to its owner's held list */
+static void mutex_add_held(task_t *task, mutex_t *mutex) {
+    mutex->next_held = task->held_mutexes;
+    task->held_mutexes = mutex;
+}
+
+/* Remove mutex from its owner's held list */
+static void mutex_remove_held(task_t *task, mutex_t *mutex) {
+    mutex_t **link = &task->held_mutexes;
+    
+    while (*link) {
+        if (*link == mutex) {
+            *link = mutex->next_held;
+            break;
+        }
+        link = &(*link)->next_held;
+    }
+    
+    mutex->next_held = NULL;
+}
+
+/* Highest of the base priority and the top waiter of every held mutex */
+static uint8_t mutex_inherited_priority(task_t *task) {
+    mutex_t *mutex;
+    task_t *waiter;
+    uint8_t priority = task->base_priority;
+    
+    for (mutex = task->held_mutexes; mutex; mutex = mutex->next_held) {
+        waiter = waitq_peek(&mutex->waiters);
+        if (waiter && waiter->priority > priority) {
+            priority = waiter->priority;
+        }
+    }
+    
+    return priority;
+}
+
+/* Recompute a task's priority and propagate along the blocking chain */
+void mutex_update_priority(task_t *task) {
+    uint32_t depth = 0;
+    uint8_t priority;
+    
+    /* Bounded walk guards against deadlock cycles */
+    while (task && depth++ < MAX_TASKS) {
+        priority = mutex_inherited_priority(task);
+        if (priority == task->priority) {
+            break;
+        }
+        
+        scheduler_set_priority(task, priority);
+        task = task->wait_mutex ? task->wait_mutex->owner : NULL;
+    }
+}
+
+/* Initialize a mutex */
+int32_t mutex_init(mutex_t *mutex) {
+    if (!mutex) {
+        return ERROR;
+    }
+    
+    mutex->owner = NULL;
+    mutex->lock_count = 0;
+    waitq_init(&mutex->waiters, WAITQ_PRIORITY);
+    mutex->next_held = NULL;
+    mutex->valid = TRUE;
+    
+    return SUCCESS;
+}
+
+/* Lock a mutex, boosting the owner chain while we wait */
+int32_t mutex_lock(mutex_t *mutex, uint32_t timeout_ms) {
+    task_t *current;
+    task_t *owner;
+    int32_t result;
+    
+    if (!mutex || !mutex->valid) {
+        return ERROR;
+    }
+    
+    current = task_get_current();
+    if (!current) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    if (!mutex->owner) {
+        mutex->owner = current;
+        mutex->lock_count = 1;
+        mutex_add_held(current, mutex);
+        scheduler_enable_preemption();
+        return SUCCESS;
+    }
+    
+    if (mutex->owner == current) {
+        mutex->lock_count++;
+        scheduler_enable_preemption();
+        return SUCCESS;
+    }
+    
+    /* Contended: queue up, then lend our priority down the chain */
+    current->wait_mutex = mutex;
+    waitq_enqueue(&mutex->waiters, current);
+    mutex_update_priority(mutex->owner);
+    
+    /* mutex_unlock() hands ownership over before waking us */
+    result = waitq_sleep(&mutex->waiters, mutex, timeout_ms);
+    
+    if (result != SUCCESS) {
+        scheduler_disable_preemption();
+        current->wait_mutex = NULL;
+        owner = mutex->owner;
+        if (owner) {
+            mutex_update_priority(owner);
+        }
+        scheduler_enable_preemption();
+    }
+    
+    return result;
+}
+
+/* Lock a mutex without blocking */
+int32_t mutex_trylock(mutex_t *mutex) {
+    task_t *current;
+    int32_t result = ERROR;
+    
+    if (!mutex || !mutex->valid) {
+        return ERROR;
+    }
+    
+    current = task_get_current();
+    if (!current) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    if (!mutex->owner) {
+        mutex->owner = current;
+        mutex->lock_count = 1;
+        mutex_add_held(current, mutex);
+        result = SUCCESS;
+    } else if (mutex->owner == current) {
+        mutex->lock_count++;
+        result = SUCCESS;
+    }
+    
+    scheduler_enable_preemption();
+    
+    return result;
+}
+
+/* Release a mutex completely, handing it to the highest-priority waiter
+ * (preemption already disabled, caller is the owner) */
+void mutex_release(mutex_t *mutex) {
+    task_t *owner = mutex->owner;
+    task_t *next;
+    
+    mutex_remove_held(owner, mutex);
+    mutex->owner = NULL;
+    mutex->lock_count = 0;
+    
+    next = waitq_wake_one(&mutex->waiters);
+    if (next) {
+        next->wait_mutex = NULL;
+        mutex->owner = next;
+        mutex->lock_count = 1;
+        mutex_add_held(next, mutex);
+        mutex_update_priority(next);
+    }
+    
+    /* Drop whatever we inherited through this mutex */
+    mutex_update_priority(owner);
+}
+
+/* Unlock a mutex, handing it to the highest-priority waiter */
+int32_t mutex_unlock(mutex_t *mutex) {
+    task_t *current;
+    
+    if (!mutex || !mutex->valid) {
+        return ERROR;
+    }
+    
+    current = task_get_current();
+    if (!current || mutex->owner != current) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    if (--mutex->lock_count == 0) {
+        mutex_release(mutex);
+    }
+    
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
+/* Destroy a mutex */
+int32_t mutex_destroy(mutex_t *mutex) {
+    task_t *owner;
+    
+    if (!mutex || !mutex->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    mutex->valid = FALSE;
+    owner = mutex->owner;
+    
+    /* Wake up all waiting tasks */
+    waitq_wake_all(&mutex->waiters, ERROR);
+    
+    if (owner) {
+        mutex_remove_held(owner, mutex);
+        mutex->owner = NULL;
+        mutex->lock_count = 0;
+        mutex_update_priority(owner);
+    }
+    
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
+/* Get mutex owner */
+task_t *mutex_get_owner(mutex_t *mutex) {
+    if (!mutex || !mutex->valid) {
+        return NULL;
+    }
+    
+    return mutex->owner;
+}
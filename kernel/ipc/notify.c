@@ -0,0 +1,121 @@
+#include "../include/notify.h"
+#include "../include/scheduler.h"
+#include "../include/irq.h"
+#include "../include/spinlock.h"
+
+/* Guards every task's notification state */
+static spinlock_t notify_lock;
+
+/* Apply a notification; returns TRUE if the target must be woken.
+ * Called with notify_lock held. */
+static bool_t notify_update(task_t *task, uint32_t value, uint32_t action) {
+    switch (action) {
+        case NOTIFY_SET_BITS:
+            task->notify_value |= value;
+            break;
+        case NOTIFY_INCREMENT:
+            task->notify_value++;
+            break;
+        case NOTIFY_OVERWRITE:
+            task->notify_value = value;
+            break;
+        default:
+            return FALSE;
+    }
+    
+    task->notify_pending = TRUE;
+    
+    if (task->notify_waiting) {
+        task->notify_waiting = FALSE;
+        task->wake_time = 0;
+        return TRUE;
+    }
+    
+    return FALSE;
+}
+
+/* Notify a task, waking it if it is waiting */
+int32_t task_notify(task_t *task, uint32_t value, uint32_t action) {
+    irq_flags_t flags;
+    
+    if (!task || action > NOTIFY_OVERWRITE) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&notify_lock);
+    if (notify_update(task, value, action)) {
+        scheduler_unblock_task_from_isr(task);
+    }
+    spin_unlock_irqrestore(&notify_lock, flags);
+    
+    return SUCCESS;
+}
+
+/* Notify a task from an interrupt handler */
+int32_t task_notify_from_isr(task_t *task, uint32_t value, uint32_t action) {
+    if (!task || action > NOTIFY_OVERWRITE) {
+        return ERROR;
+    }
+    
+    spin_lock(&notify_lock);
+    if (notify_update(task, value, action)) {
+        scheduler_unblock_task_from_isr(task);
+    }
+    spin_unlock(&notify_lock);
+    
+    return SUCCESS;
+}
+
+/* Wait for a notification to the current task
+ *
+ * clear_on_entry bits are cleared only if nothing is pending yet;
+ * clear_on_exit bits are cleared after the value is read.
+ */
+int32_t task_notify_wait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                         uint32_t *value_out, uint32_t timeout_ms) {
+    task_t *current = task_get_current();
+    int32_t result = ERROR;
+    irq_flags_t flags;
+    
+    if (!current) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&notify_lock);
+    
+    if (!current->notify_pending) {
+        current->notify_value &= ~clear_on_entry;
+        current->notify_waiting = TRUE;
+        
+        if (timeout_ms > 0) {
+            current->wake_time = scheduler_get_tick_count() +
+                                 (timeout_ms * TIMER_FREQ_HZ) / 1000;
+        } else {
+            current->wake_time = 0;
+        }
+        
+        /* No wait queue: the notifier unblocks us directly. We are marked
+         * blocked before the lock drops, so no wake-up is lost. */
+        scheduler_block_task(current);
+        spin_unlock(&notify_lock);
+        schedule();
+        spin_lock(&notify_lock);
+        
+        current->notify_waiting = FALSE;
+    }
+    
+    if (current->notify_pending) {
+        if (value_out) {
+            *value_out = current->notify_value;
+        }
+        current->notify_value &= ~clear_on_exit;
+        current->notify_pending = FALSE;
+        result = SUCCESS;
+    } else if (value_out) {
+        *value_out = current->notify_value;
+    }
+    
+    spin_unlock_irqrestore(&notify_lock, flags);
+    
+    return result;
+}
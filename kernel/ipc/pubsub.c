@@ -0,0 +1,168 @@
+#include "../include/pubsub.h"
+#include "../include/scheduler.h"
+#include "../include/memory.h"
+
+/* Create a topic
+ *
+ * The capacity is rounded up to a power of two, so a slot is the sequence
+ * number masked and stays right when the 32-bit counters wrap.
+ */
+int32_t topic_create(topic_t **topic, uint32_t capacity) {
+    topic_t *t;
+    uint32_t slots = 1;
+    
+    if (!topic || capacity == 0 || capacity > 0x80000000) {
+        return ERROR;
+    }
+    
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+    capacity = slots;
+    
+    t = (topic_t *)kmalloc(sizeof(topic_t));
+    if (!t) {
+        return ERROR;
+    }
+    
+    t->ring = (void **)kmalloc(sizeof(void *) * capacity);
+    if (!t->ring) {
+        kfree(t);
+        return ERROR;
+    }
+    
+    t->capacity = capacity;
+    t->seq = 0;
+    waitq_init(&t->waiters, WAITQ_PRIORITY);
+    t->subscribers = 0;
+    t->valid = TRUE;
+    
+    *topic = t;
+    
+    return SUCCESS;
+}
+
+/* Publish a message to every subscriber
+ *
+ * Constant work per publish: one slot store and a sequence bump. Only
+ * subscribers actually blocked in topic_receive() need waking.
+ */
+int32_t topic_publish(topic_t *topic, void *msg) {
+    if (!topic || !topic->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    topic->ring[topic->seq & (topic->capacity - 1)] = msg;
+    topic->seq++;
+    
+    if (!waitq_empty(&topic->waiters)) {
+        waitq_wake_all(&topic->waiters, SUCCESS);
+    }
+    
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
+/* Destroy a topic */
+int32_t topic_destroy(topic_t *topic) {
+    if (!topic || !topic->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    topic->valid = FALSE;
+    waitq_wake_all(&topic->waiters, ERROR);
+    scheduler_enable_preemption();
+    
+    kfree(topic->ring);
+    kfree(topic);
+    
+    return SUCCESS;
+}
+
+/* Subscribe; only messages published from now on are seen */
+int32_t topic_subscribe(topic_t *topic, subscriber_t *sub) {
+    if (!topic || !topic->valid || !sub) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    sub->topic = topic;
+    sub->cursor = topic->seq;
+    sub->overruns = 0;
+    topic->subscribers++;
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
+/* Unsubscribe */
+int32_t topic_unsubscribe(subscriber_t *sub) {
+    if (!sub || !sub->topic || !sub->topic->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    sub->topic->subscribers--;
+    sub->topic = NULL;
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
+/* Receive the next message for this subscriber
+ *
+ * Returns SUCCESS, TOPIC_OVERRUN if older messages were overwritten before
+ * they could be read (the cursor skips to the oldest one still held), or
+ * ERROR on timeout.
+ */
+int32_t topic_receive(subscriber_t *sub, void **msg, uint32_t timeout_ms) {
+    topic_t *topic;
+    uint32_t behind;
+    int32_t result = SUCCESS;
+    
+    if (!sub || !msg || !sub->topic || !sub->topic->valid) {
+        return ERROR;
+    }
+    
+    topic = sub->topic;
+    scheduler_disable_preemption();
+    
+    while (topic->seq == sub->cursor) {
+        if (waitq_block(&topic->waiters, topic, timeout_ms) != SUCCESS) {
+            return ERROR;
+        }
+        scheduler_disable_preemption();
+    }
+    
+    /* Slow reader: the publisher has lapped us */
+    behind = topic->seq - sub->cursor;
+    if (behind > topic->capacity) {
+        sub->overruns += behind - topic->capacity;
+        sub->cursor = topic->seq - topic->capacity;
+        result = TOPIC_OVERRUN;
+    }
+    
+    *msg = topic->ring[sub->cursor & (topic->capacity - 1)];
+    sub->cursor++;
+    
+    scheduler_enable_preemption();
+    
+    return result;
+}
+
+/* Number of messages this subscriber has not read yet (capped at capacity) */
+uint32_t topic_get_pending(subscriber_t *sub) {
+    uint32_t behind;
+    
+    if (!sub || !sub->topic || !sub->topic->valid) {
+        return 0;
+    }
+    
+    behind = sub->topic->seq - sub->cursor;
+    
+    return (behind > sub->topic->capacity) ? sub->topic->capacity : behind;
+}
@@ -1,14 +1,125 @@
 #include "../include/queue.h"
+#include "../include/bitops.h"
 #include "../include/memory.h"
+#include "../include/scheduler.h"
+
+#define QUEUE_NIL           0xFFFF  /* End of a slot list */
+
+/* Per-priority message lists for QUEUE_PRIO_MSG queues
+ *
+ * Slots of the message buffer are chained into one FIFO list per priority
+ * plus a free list, so both send and receive are O(1) whatever the depth.
+ */
+typedef struct queue_prio {
+    uint16_t head[QUEUE_MSG_LEVELS];    /* First slot per priority */
+    uint16_t tail[QUEUE_MSG_LEVELS];    /* Last slot per priority */
+    uint32_t bitmap;                    /* Bit n set if priority n has messages */
+    uint16_t free_head;                 /* First free slot */
+    uint16_t next[];                    /* Slot links */
+} queue_prio_t;
+
+/* Set up the slot lists of a priority queue */
+static queue_prio_t *queue_prio_create(uint32_t capacity) {
+    queue_prio_t *prio;
+    uint32_t i;
+    
+    prio = (queue_prio_t *)kmalloc(sizeof(queue_prio_t) + sizeof(uint16_t) * capacity);
+    if (!prio) {
+        return NULL;
+    }
+    
+    for (i = 0; i < QUEUE_MSG_LEVELS; i++) {
+        prio->head[i] = QUEUE_NIL;
+        prio->tail[i] = QUEUE_NIL;
+    }
+    
+    for (i = 0; i < capacity; i++) {
+        prio->next[i] = (i + 1 < capacity) ? (uint16_t)(i + 1) : QUEUE_NIL;
+    }
+    
+    prio->bitmap = 0;
+    prio->free_head = 0;
+    
+    return prio;
+}
+
+/* Store a message (mutex held, space reserved) */
+static void queue_put(queue_t *queue, void *msg, uint8_t priority) {
+    queue_prio_t *prio = queue->prio;
+    uint16_t slot;
+    
+    if (!prio) {
+        queue->buffer[queue->tail] = msg;
+        queue->tail = (queue->tail + 1) % queue->capacity;
+        queue->count++;
+        return;
+    }
+    
+    slot = prio->free_head;
+    prio->free_head = prio->next[slot];
+    
+    queue->buffer[slot] = msg;
+    prio->next[slot] = QUEUE_NIL;
+    
+    if (prio->tail[priority] == QUEUE_NIL) {
+        prio->head[priority] = slot;
+        prio->bitmap |= (1U << priority);
+    } else {
+        prio->next[prio->tail[priority]] = slot;
+    }
+    prio->tail[priority] = slot;
+    queue->count++;
+}
+
+/* Fetch the next message (mutex held, a message is reserved) */
+static void *queue_get(queue_t *queue) {
+    queue_prio_t *prio = queue->prio;
+    uint32_t lvl;
+    uint16_t slot;
+    void *msg;
+    
+    if (!prio) {
+        msg = queue->buffer[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        return msg;
+    }
+    
+    lvl = bit_highest(prio->bitmap);
+    slot = prio->head[lvl];
+    
+    prio->head[lvl] = prio->next[slot];
+    if (prio->head[lvl] == QUEUE_NIL) {
+        prio->tail[lvl] = QUEUE_NIL;
+        prio->bitmap &= ~(1U << lvl);
+    }
+    
+    msg = queue->buffer[slot];
+    prio->next[slot] = prio->free_head;
+    prio->free_head = slot;
+    queue->count--;
+    
+    return msg;
+}
 
 /* Create a message queue */
 int32_t queue_create(queue_t **queue, uint32_t capacity) {
+    return queue_create_ex(queue, capacity, 0);
+}
+
+/* Create a message queue with creation flags */
+int32_t queue_create_ex(queue_t **queue, uint32_t capacity, uint32_t flags) {
     queue_t *q;
+    uint32_t sem_flags;
     
     if (!queue || capacity == 0) {
         return ERROR;
     }
     
+    if ((flags & QUEUE_PRIO_MSG) && capacity >= QUEUE_NIL) {
+        return ERROR;
+    }
+    
     q = (queue_t *)kmalloc(sizeof(queue_t));
     if (!q) {
         return ERROR;
@@ -20,25 +131,40 @@ int32_t queue_create(queue_t **queue, uint32_t capacity) {
         return ERROR;
     }
     
+    q->prio = NULL;
+    if (flags & QUEUE_PRIO_MSG) {
+        q->prio = queue_prio_create(capacity);
+        if (!q->prio) {
+            kfree(q->buffer);
+            kfree(q);
+            return ERROR;
+        }
+    }
+    
     q->capacity = capacity;
     q->count = 0;
     q->head = 0;
     q->tail = 0;
+    q->flags = flags;
+    sem_flags = (flags & QUEUE_PRIO_WAIT) ? SEM_PRIO_WAIT : 0;
     
     /* Initialize semaphores */
-    if (sem_init(&q->mutex, 1, 1) != SUCCESS) {
+    if (mutex_init(&q->mutex) != SUCCESS) {
+        kfree(q->prio);
         kfree(q->buffer);
         kfree(q);
         return ERROR;
     }
     
-    if (sem_init(&q->not_empty, 0, capacity) != SUCCESS) {
+    if (sem_init_ex(&q->not_empty, 0, capacity, sem_flags) != SUCCESS) {
+        kfree(q->prio);
         kfree(q->buffer);
         kfree(q);
         return ERROR;
     }
     
-    if (sem_init(&q->not_full, capacity, capacity) != SUCCESS) {
+    if (sem_init_ex(&q->not_full, capacity, capacity, sem_flags) != SUCCESS) {
+        kfree(q->prio);
         kfree(q->buffer);
         kfree(q);
         return ERROR;
@@ -52,7 +178,13 @@ int32_t queue_create(queue_t **queue, uint32_t capacity) {
 
 /* Send message to queue */
 int32_t queue_send(queue_t *queue, void *msg, uint32_t timeout_ms) {
-    if (!queue || !queue->valid) {
+    return queue_send_prio(queue, msg, 0, timeout_ms);
+}
+
+/* Send message with a priority (ignored unless QUEUE_PRIO_MSG) */
+int32_t queue_send_prio(queue_t *queue, void *msg, uint8_t priority,
+                        uint32_t timeout_ms) {
+    if (!queue || !queue->valid || priority >= QUEUE_MSG_LEVELS) {
         return ERROR;
     }
     
@@ -62,18 +194,16 @@ int32_t queue_send(queue_t *queue, void *msg, uint32_t timeout_ms) {
     }
     
     /* Acquire mutex */
-    if (sem_wait(&queue->mutex, timeout_ms) != SUCCESS) {
+    if (mutex_lock(&queue->mutex, timeout_ms) != SUCCESS) {
         sem_post(&queue->not_full);
         return ERROR;
     }
     
     /* Add message to queue */
-    queue->buffer[queue->tail] = msg;
-    queue->tail = (queue->tail + 1) % queue->capacity;
-    queue->count++;
+    queue_put(queue, msg, priority);
     
     /* Release mutex */
-    sem_post(&queue->mutex);
+    mutex_unlock(&queue->mutex);
     
     /* Signal that queue is not empty */
     sem_post(&queue->not_empty);
@@ -81,30 +211,48 @@ int32_t queue_send(queue_t *queue, void *msg, uint32_t timeout_ms) {
     return SUCCESS;
 }
 
-/* Receive message from queue */
-int32_t queue_receive(queue_t *queue, void **msg, uint32_t timeout_ms) {
-    if (!queue || !queue->valid || !msg) {
+/* Send a message from an interrupt handler
+ *
+ * Never blocks: fails if the queue is full or a task is in the middle of a
+ * queue operation (the handler cannot wait for the mutex). Any receiver
+ * woken runs at interrupt exit.
+ */
+int32_t queue_send_from_isr(queue_t *queue, void *msg, uint8_t priority) {
+    if (!queue || !queue->valid || priority >= QUEUE_MSG_LEVELS) {
         return ERROR;
     }
     
-    /* Wait for message in queue */
-    if (sem_wait(&queue->not_empty, timeout_ms) != SUCCESS) {
+    /* Holding the kernel lock keeps tasks on other CPUs from taking the
+     * mutex, so a free mutex stays free until we are done */
+    if (!scheduler_try_disable_preemption()) {
+        return ERROR;
+    }
+    
+    if (queue->mutex.owner || sem_trywait(&queue->not_full) != SUCCESS) {
+        scheduler_enable_preemption();
         return ERROR;
     }
     
+    queue_put(queue, msg, priority);
+    sem_post_from_isr(&queue->not_empty);
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
+/* Dequeue a message once a not_empty unit is held (kernel internal) */
+int32_t queue_take(queue_t *queue, void **msg, uint32_t timeout_ms) {
     /* Acquire mutex */
-    if (sem_wait(&queue->mutex, timeout_ms) != SUCCESS) {
+    if (mutex_lock(&queue->mutex, timeout_ms) != SUCCESS) {
         sem_post(&queue->not_empty);
         return ERROR;
     }
     
     /* Get message from queue */
-    *msg = queue->buffer[queue->head];
-    queue->head = (queue->head + 1) % queue->capacity;
-    queue->count--;
+    *msg = queue_get(queue);
     
     /* Release mutex */
-    sem_post(&queue->mutex);
+    mutex_unlock(&queue->mutex);
     
     /* Signal that queue is not full */
     sem_post(&queue->not_full);
@@ -112,6 +260,59 @@ int32_t queue_receive(queue_t *queue, void **msg, uint32_t timeout_ms) {
     return SUCCESS;
 }
 
+/* Receive message from queue */
+int32_t queue_receive(queue_t *queue, void **msg, uint32_t timeout_ms) {
+    if (!queue || !queue->valid || !msg) {
+        return ERROR;
+    }
+    
+    /* Wait for message in queue */
+    if (sem_wait(&queue->not_empty, timeout_ms) != SUCCESS) {
+        return ERROR;
+    }
+    
+    return queue_take(queue, msg, timeout_ms);
+}
+
+/* Receive a message if one is queued (task context)
+ *
+ * Never waits for a message; it only blocks briefly for the queue mutex,
+ * and a sender waiting for space is woken right away.
+ */
+int32_t queue_tryreceive(queue_t *queue, void **msg) {
+    if (!queue || !queue->valid || !msg) {
+        return ERROR;
+    }
+    
+    if (sem_trywait(&queue->not_empty) != SUCCESS) {
+        return ERROR;
+    }
+    
+    return queue_take(queue, msg, 0);
+}
+
+/* Receive a message from an interrupt handler without blocking */
+int32_t queue_receive_from_isr(queue_t *queue, void **msg) {
+    if (!queue || !queue->valid || !msg) {
+        return ERROR;
+    }
+    
+    if (!scheduler_try_disable_preemption()) {
+        return ERROR;
+    }
+    
+    if (queue->mutex.owner || sem_trywait(&queue->not_empty) != SUCCESS) {
+        scheduler_enable_preemption();
+        return ERROR;
+    }
+    
+    *msg = queue_get(queue);
+    sem_post_from_isr(&queue->not_full);
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
 /* Destroy a queue */
 int32_t queue_destroy(queue_t *queue) {
     if (!queue || !queue->valid) {
@@ -120,10 +321,13 @@ int32_t queue_destroy(queue_t *queue) {
     
     queue->valid = FALSE;
     
-    sem_destroy(&queue->mutex);
+    mutex_destroy(&queue->mutex);
     sem_destroy(&queue->not_empty);
     sem_destroy(&queue->not_full);
     
+    if (queue->prio) {
+        kfree(queue->prio);
+    }
     kfree(queue->buffer);
     kfree(queue);
     
@@ -138,9 +342,9 @@ uint32_t queue_get_count(queue_t *queue) {
         return 0;
     }
     
-    sem_wait(&queue->mutex, 0);
+    mutex_lock(&queue->mutex, 0);
     count = queue->count;
-    sem_post(&queue->mutex);
+    mutex_unlock(&queue->mutex);
     
     return count;
 }
@@ -1,152 +1,193 @@
 #include "../include/semaphore.h"
 #include "../include/scheduler.h"
+#include "../include/atomic.h"
 #include "../include/memory.h"
+#include "../include/smp.h"
+#include "../include/config.h"
 
-/* Add task to semaphore wait queue */
-static void sem_add_waiter(semaphore_t *sem, task_t *task) {
-    if (!sem->wait_queue) {
-        sem->wait_queue = task;
-        task->next = task;
-        task->prev = task;
-    } else {
-        task->next = sem->wait_queue;
-        task->prev = sem->wait_queue->prev;
-        sem->wait_queue->prev->next = task;
-        sem->wait_queue->prev = task;
-    }
+/* Path counters, one cache line per CPU so the lock-free fast paths never
+ * write a line shared between CPUs */
+typedef struct {
+    sem_stats_t stats;
+} __attribute__((aligned(64))) sem_cpu_stats_t;
+
+static sem_cpu_stats_t sem_stats[MAX_CPUS];
+
+/* Get this CPU's counters
+ *
+ * Read with interrupts enabled: a migration in between only credits
+ * another CPU's line, and the counters are bumped with a locked add, so
+ * no count is lost either way.
+ */
+static sem_stats_t *sem_cpu_stats(void) {
+    return &sem_stats[cpu_self()->id].stats;
 }
 
-/* Remove task from semaphore wait queue */
-static task_t *sem_remove_waiter(semaphore_t *sem) {
-    task_t *task;
-    
-    if (!sem->wait_queue) {
-        return NULL;
+/* Take one unit if available (lock-free) */
+static bool_t sem_try_take(semaphore_t *sem) {
+    uint32_t count = sem->count;
+    uint32_t prev;
+    
+    while (count > 0) {
+        prev = atomic_cmpxchg(&sem->count, count, count - 1);
+        if (prev == count) {
+            return TRUE;
+        }
+        count = prev;
     }
     
-    task = sem->wait_queue;
-    
-    if (task->next == task) {
-        sem->wait_queue = NULL;
-    } else {
-        sem->wait_queue = task->next;
-        task->prev->next = task->next;
-        task->next->prev = task->prev;
+    return FALSE;
+}
+
+/* Return one unit, saturating at max_count (lock-free) */
+static void sem_give(semaphore_t *sem) {
+    uint32_t count = sem->count;
+    uint32_t prev;
+    
+    while (count < sem->max_count) {
+        prev = atomic_cmpxchg(&sem->count, count, count + 1);
+        if (prev == count) {
+            return;
+        }
+        count = prev;
+    }
+}
+
+/* Hand available units straight to waiters (preemption disabled)
+ *
+ * Peek skips stale entries of multi-object waits, so a taken unit always
+ * finds a taker.
+ */
+static void sem_wake_waiters(void *arg) {
+    semaphore_t *sem = (semaphore_t *)arg;
+    
+    while (waitq_peek(&sem->waiters) && sem_try_take(sem)) {
+        waitq_wake_one(&sem->waiters);
     }
-    
-    task->next = NULL;
-    task->prev = NULL;
-    
-    return task;
 }
 
 /* Initialize a semaphore */
 int32_t sem_init(semaphore_t *sem, uint32_t initial_count, uint32_t max_count) {
+    return sem_init_ex(sem, initial_count, max_count, 0);
+}
+
+/* Initialize a semaphore with creation flags */
+int32_t sem_init_ex(semaphore_t *sem, uint32_t initial_count, uint32_t max_count,
+                    uint32_t flags) {
     if (!sem || initial_count > max_count) {
         return ERROR;
     }
     
     sem->count = initial_count;
     sem->max_count = max_count;
-    sem->wait_queue = NULL;
+    waitq_init(&sem->waiters,
+               (flags & SEM_PRIO_WAIT) ? WAITQ_PRIORITY : WAITQ_FIFO);
+    defer_item_init(&sem->isr_wake, NULL, sem_wake_waiters, sem, 0);
     sem->valid = TRUE;
     
     return SUCCESS;
 }
 
-/* Wait on a semaphore (P operation) */
+/* Wait on a semaphore (P operation)
+ *
+ * Uncontended waits are a single cmpxchg on the count; only an empty
+ * semaphore touches scheduler state.
+ */
 int32_t sem_wait(semaphore_t *sem, uint32_t timeout_ms) {
     task_t *current;
-    uint32_t start_time;
     
     if (!sem || !sem->valid) {
         return ERROR;
     }
     
-    scheduler_disable_preemption();
-    
-    if (sem->count > 0) {
-        sem->count--;
-        scheduler_enable_preemption();
+    if (sem_try_take(sem)) {
+        atomic_fetch_add(&sem_cpu_stats()->fast_waits, 1);
         return SUCCESS;
     }
     
-    /* Need to wait */
+    atomic_fetch_add(&sem_cpu_stats()->slow_waits, 1);
+    scheduler_disable_preemption();
+    
     current = task_get_current();
     if (!current) {
         scheduler_enable_preemption();
         return ERROR;
     }
     
-    /* Add to wait queue */
-    sem_add_waiter(sem, current);
-    current->wait_obj = sem;
+    /* Queue first, then re-check: a fast-path post either sees us queued
+     * or we see its unit */
+    waitq_enqueue(&sem->waiters, current);
+    if (sem_try_take(sem)) {
+        waitq_remove(&sem->waiters, current);
+        scheduler_enable_preemption();
+        return SUCCESS;
+    }
     
-    if (timeout_ms > 0) {
-        start_time = scheduler_get_tick_count();
-        current->wake_time = start_time + (timeout_ms * TIMER_FREQ_HZ) / 1000;
+    /* sem_post() takes the unit on our behalf before waking us */
+    return waitq_sleep(&sem->waiters, sem, timeout_ms);
+}
+
+/* Take a unit only if one is available */
+int32_t sem_trywait(semaphore_t *sem) {
+    if (!sem || !sem->valid) {
+        return ERROR;
     }
     
-    scheduler_enable_preemption();
-    scheduler_block_task(current);
-    schedule();
-    
-    /* Check if timed out */
-    if (timeout_ms > 0 && current->wait_obj == sem) {
-        /* Timed out, remove from wait queue */
-        scheduler_disable_preemption();
-        if (current->next) {
-            if (current->next == current) {
-                sem->wait_queue = NULL;
-            } else {
-                if (sem->wait_queue == current) {
-                    sem->wait_queue = current->next;
-                }
-                current->prev->next = current->next;
-                current->next->prev = current->prev;
-            }
-            current->next = NULL;
-            current->prev = NULL;
-        }
-        current->wait_obj = NULL;
-        scheduler_enable_preemption();
+    if (!sem_try_take(sem)) {
         return ERROR;
     }
     
+    atomic_fetch_add(&sem_cpu_stats()->fast_waits, 1);
     return SUCCESS;
 }
 
 /* Post to a semaphore (V operation) */
 int32_t sem_post(semaphore_t *sem) {
-    task_t *task;
-    
     if (!sem || !sem->valid) {
         return ERROR;
     }
     
-    scheduler_disable_preemption();
+    sem_give(sem);
     
-    if (sem->wait_queue) {
-        /* Wake up a waiting task */
-        task = sem_remove_waiter(sem);
-        if (task) {
-            task->wait_obj = NULL;
-            task->wake_time = 0;
-            scheduler_unblock_task(task);
-        }
-    } else if (sem->count < sem->max_count) {
-        sem->count++;
+    if (waitq_empty(&sem->waiters)) {
+        atomic_fetch_add(&sem_cpu_stats()->fast_posts, 1);
+        return SUCCESS;
     }
     
+    atomic_fetch_add(&sem_cpu_stats()->slow_posts, 1);
+    scheduler_disable_preemption();
+    sem_wake_waiters(sem);
     scheduler_enable_preemption();
     
     return SUCCESS;
 }
 
+/* Post to a semaphore from an interrupt handler
+ *
+ * Never blocks and never touches the wait queue: the unit is returned
+ * atomically and any wake-up is left to interrupt exit (or to the end of
+ * the critical section the handler interrupted).
+ */
+int32_t sem_post_from_isr(semaphore_t *sem) {
+    if (!sem || !sem->valid) {
+        return ERROR;
+    }
+    
+    sem_give(sem);
+    
+    if (waitq_empty(&sem->waiters)) {
+        atomic_fetch_add(&sem_cpu_stats()->fast_posts, 1);
+        return SUCCESS;
+    }
+    
+    atomic_fetch_add(&sem_cpu_stats()->slow_posts, 1);
+    defer_queue_from_isr(&sem->isr_wake);
+    
+    return SUCCESS;
+}
+
 /* Destroy a semaphore */
 int32_t sem_destroy(semaphore_t *sem) {
-    task_t *task;
-    
     if (!sem || !sem->valid) {
         return ERROR;
     }
@@ -154,15 +195,10 @@ int32_t sem_destroy(semaphore_t *sem) {
     scheduler_disable_preemption();
     
     /* Wake up all waiting tasks */
-    while (sem->wait_queue) {
-        task = sem_remove_waiter(sem);
-        if (task) {
-            task->wait_obj = NULL;
-            scheduler_unblock_task(task);
-        }
-    }
-    
     sem->valid = FALSE;
+    defer_cancel(&sem->isr_wake);
+    waitq_wake_all(&sem->waiters, ERROR);
+    
     scheduler_enable_preemption();
     
     return SUCCESS;
@@ -176,3 +212,24 @@ int32_t sem_get_count(semaphore_t *sem) {
     
     return (int32_t)sem->count;
 }
+
+/* Get fast/slow path statistics */
+void sem_get_stats(sem_stats_t *stats) {
+    uint32_t i;
+    
+    if (!stats) {
+        return;
+    }
+    
+    stats->fast_waits = 0;
+    stats->slow_waits = 0;
+    stats->fast_posts = 0;
+    stats->slow_posts = 0;
+    
+    for (i = 0; i < MAX_CPUS; i++) {
+        stats->fast_waits += sem_stats[i].stats.fast_waits;
+        stats->slow_waits += sem_stats[i].stats.slow_waits;
+        stats->fast_posts += sem_stats[i].stats.fast_posts;
+        stats->slow_posts += sem_stats[i].stats.slow_posts;
+    }
+}
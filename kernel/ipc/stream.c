@@ -0,0 +1,250 @@
+#include "../include/stream.h"
+#include "../include/scheduler.h"
+#include "../include/memory.h"
+
+/* Copy into the ring, at most two contiguous spans */
+static uint32_t stream_put(stream_t *stream, const uint8_t *data, uint32_t len) {
+    uint32_t space = stream->size - stream->count;
+    uint32_t first;
+    
+    if (len > space) {
+        len = space;
+    }
+    
+    first = stream->size - stream->tail;
+    if (first > len) {
+        first = len;
+    }
+    
+    memcpy(stream->buffer + stream->tail, data, first);
+    memcpy(stream->buffer, data + first, len - first);
+    
+    stream->tail = (stream->tail + len) % stream->size;
+    stream->count += len;
+    
+    return len;
+}
+
+/* Copy out of the ring, at most two contiguous spans */
+static uint32_t stream_get(stream_t *stream, uint8_t *buf, uint32_t len) {
+    uint32_t first;
+    
+    if (len > stream->count) {
+        len = stream->count;
+    }
+    
+    first = stream->size - stream->head;
+    if (first > len) {
+        first = len;
+    }
+    
+    memcpy(buf, stream->buffer + stream->head, first);
+    memcpy(buf + first, stream->buffer, len - first);
+    
+    stream->head = (stream->head + len) % stream->size;
+    stream->count -= len;
+    
+    return len;
+}
+
+/* Wake filter: the first reader whose threshold (kept in node->mask) the
+ * buffered bytes now meet */
+static bool_t stream_match(wait_node_t *node, void *arg) {
+    stream_t *stream = (stream_t *)arg;
+    
+    if (stream->count < node->mask || stream->waking) {
+        return FALSE;
+    }
+    
+    stream->waking = TRUE;
+    
+    return TRUE;
+}
+
+/* Wake one reader that the buffered data satisfies (preemption disabled) */
+static void stream_wake_reader(stream_t *stream) {
+    if (stream->count == 0 || waitq_empty(&stream->readers)) {
+        return;
+    }
+    
+    stream->waking = FALSE;
+    waitq_wake_if(&stream->readers, stream_match, stream);
+}
+
+/* Create a stream buffer */
+int32_t stream_create(stream_t **stream, uint32_t size, uint32_t trigger) {
+    stream_t *s;
+    
+    if (!stream || size == 0) {
+        return ERROR;
+    }
+    
+    s = (stream_t *)kmalloc(sizeof(stream_t));
+    if (!s) {
+        return ERROR;
+    }
+    
+    s->buffer = (uint8_t *)kmalloc(size);
+    if (!s->buffer) {
+        kfree(s);
+        return ERROR;
+    }
+    
+    s->size = size;
+    s->head = 0;
+    s->tail = 0;
+    s->count = 0;
+    s->trigger = (trigger == 0) ? 1 : (trigger > size ? size : trigger);
+    s->waking = FALSE;
+    waitq_init(&s->readers, WAITQ_PRIORITY);
+    waitq_init(&s->writers, WAITQ_PRIORITY);
+    s->valid = TRUE;
+    
+    *stream = s;
+    
+    return SUCCESS;
+}
+
+/* Write bytes, blocking only while the stream is completely full
+ *
+ * Returns the number of bytes written (possibly fewer than len), or ERROR
+ * if nothing could be written before the timeout.
+ */
+int32_t stream_write(stream_t *stream, const void *data, uint32_t len,
+                     uint32_t timeout_ms) {
+    uint32_t written;
+    
+    if (!stream || !stream->valid || !data) {
+        return ERROR;
+    }
+    
+    if (len == 0) {
+        return 0;
+    }
+    
+    scheduler_disable_preemption();
+    
+    while (stream->count == stream->size) {
+        if (waitq_block(&stream->writers, stream, timeout_ms) != SUCCESS) {
+            return ERROR;
+        }
+        scheduler_disable_preemption();
+    }
+    
+    written = stream_put(stream, (const uint8_t *)data, len);
+    
+    /* Wake a reader only once its threshold is reached */
+    stream_wake_reader(stream);
+    
+    scheduler_enable_preemption();
+    
+    return (int32_t)written;
+}
+
+/* Read up to max_len bytes
+ *
+ * Blocks until at least min(trigger, max_len) bytes are buffered. On
+ * timeout returns whatever is available (possibly 0 bytes).
+ */
+int32_t stream_read(stream_t *stream, void *buf, uint32_t max_len,
+                    uint32_t timeout_ms) {
+    task_t *current;
+    uint32_t read;
+    
+    if (!stream || !stream->valid || !buf) {
+        return ERROR;
+    }
+    
+    if (max_len == 0) {
+        return 0;
+    }
+    
+    scheduler_disable_preemption();
+    
+    while (stream->count < stream->trigger && stream->count < max_len) {
+        current = task_get_current();
+        current->wait_node.mask = (stream->trigger < max_len) ?
+                                  stream->trigger : max_len;
+        if (waitq_block(&stream->readers, stream, timeout_ms) != SUCCESS) {
+            /* Claimed with an error means the stream was destroyed */
+            if (current->wait_fired) {
+                return ERROR;
+            }
+            scheduler_disable_preemption();
+            break;
+        }
+        scheduler_disable_preemption();
+    }
+    
+    read = stream_get(stream, (uint8_t *)buf, max_len);
+    
+    /* Space freed: let blocked writers retry */
+    if (read > 0 && !waitq_empty(&stream->writers)) {
+        waitq_wake_all(&stream->writers, SUCCESS);
+    }
+    
+    /* Leftover data may already satisfy another reader */
+    stream_wake_reader(stream);
+    
+    scheduler_enable_preemption();
+    
+    return (int32_t)read;
+}
+
+/* Change the reader trigger level */
+int32_t stream_set_trigger(stream_t *stream, uint32_t trigger) {
+    wait_node_t *node;
+    uint32_t i;
+    
+    if (!stream || !stream->valid || trigger == 0 || trigger > stream->size) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    stream->trigger = trigger;
+    
+    /* Waiters keep the threshold they blocked with; a lower trigger lowers it */
+    for (i = 0; i <= MAX_PRIORITY; i++) {
+        node = stream->readers.level[i];
+        if (!node) {
+            continue;
+        }
+        do {
+            if (node->mask > trigger) {
+                node->mask = trigger;
+            }
+            node = node->next;
+        } while (node != stream->readers.level[i]);
+    }
+    stream_wake_reader(stream);
+    scheduler_enable_preemption();
+    
+    return SUCCESS;
+}
+
+/* Get number of buffered bytes */
+uint32_t stream_get_count(stream_t *stream) {
+    if (!stream || !stream->valid) {
+        return 0;
+    }
+    
+    return stream->count;
+}
+
+/* Destroy a stream buffer */
+int32_t stream_destroy(stream_t *stream) {
+    if (!stream || !stream->valid) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    stream->valid = FALSE;
+    waitq_wake_all(&stream->readers, ERROR);
+    waitq_wake_all(&stream->writers, ERROR);
+    scheduler_enable_preemption();
+    
+    kfree(stream->buffer);
+    kfree(stream);
+    
+    return SUCCESS;
+}
@@ -0,0 +1,291 @@
+#include "../include/waitq.h"
+#include "../include/scheduler.h"
+#include "../include/bitops.h"
+
+/* Claim a queued waiter for the waker and make it runnable */
+static void waitq_claim(wait_queue_t *wq, wait_node_t *node, int32_t result) {
+    task_t *task = node->task;
+
+    waitq_del(wq, node);
+    task->wait_pending = FALSE;
+    task->wait_fired = node;
+    task->wait_obj = NULL;
+    task->wait_result = result;
+    task->wake_time = 0;
+    scheduler_unblock_task(task);
+}
+
+/* First node whose task is still waiting; drops nodes already claimed
+ * through another queue */
+static wait_node_t *waitq_first(wait_queue_t *wq) {
+    wait_node_t *node;
+
+    while (wq->bitmap) {
+        node = wq->level[bit_highest(wq->bitmap)];
+        if (node->task->wait_pending) {
+            return node;
+        }
+        waitq_del(wq, node);
+    }
+
+    return NULL;
+}
+
+/* Initialize a wait queue */
+void waitq_init(wait_queue_t *wq, uint8_t policy) {
+    int32_t i;
+
+    for (i = 0; i <= MAX_PRIORITY; i++) {
+        wq->level[i] = NULL;
+    }
+
+    wq->bitmap = 0;
+    wq->count = 0;
+    wq->policy = policy;
+}
+
+/* Append node to the tail of its level and mark its task as waiting */
+void waitq_add(wait_queue_t *wq, wait_node_t *node) {
+    uint8_t lvl;
+    wait_node_t *head;
+
+    lvl = (wq->policy == WAITQ_PRIORITY) ? node->task->priority : 0;
+    head = wq->level[lvl];
+
+    if (!head) {
+        wq->level[lvl] = node;
+        node->next = node;
+        node->prev = node;
+        wq->bitmap |= (1U << lvl);
+    } else {
+        node->next = head;
+        node->prev = head->prev;
+        head->prev->next = node;
+        head->prev = node;
+    }
+
+    node->queue = wq;
+    node->level = lvl;
+    node->task->wait_pending = TRUE;
+    wq->count++;
+}
+
+/* Unlink node from the wait queue it is on */
+void waitq_del(wait_queue_t *wq, wait_node_t *node) {
+    uint8_t lvl;
+
+    if (node->queue != wq) {
+        return;
+    }
+
+    lvl = node->level;
+
+    if (node->next == node) {
+        wq->level[lvl] = NULL;
+        wq->bitmap &= ~(1U << lvl);
+    } else {
+        if (wq->level[lvl] == node) {
+            wq->level[lvl] = node->next;
+        }
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+    }
+
+    node->next = NULL;
+    node->prev = NULL;
+    node->queue = NULL;
+    wq->count--;
+}
+
+/* Queue a task through its embedded node */
+void waitq_enqueue(wait_queue_t *wq, task_t *task) {
+    task->wait_node.task = task;
+    waitq_add(wq, &task->wait_node);
+}
+
+/* Take a task's embedded node off the queue */
+bool_t waitq_remove(wait_queue_t *wq, task_t *task) {
+    if (!task || task->wait_node.queue != wq) {
+        return FALSE;
+    }
+
+    waitq_del(wq, &task->wait_node);
+    task->wait_pending = FALSE;
+
+    return TRUE;
+}
+
+/* Move a waiter to the level matching its current priority */
+void waitq_requeue(task_t *task) {
+    wait_node_t *node = &task->wait_node;
+    wait_queue_t *wq = node->queue;
+
+    if (!wq || wq->policy != WAITQ_PRIORITY || node->level == task->priority) {
+        return;
+    }
+
+    waitq_del(wq, node);
+    waitq_add(wq, node);
+}
+
+/* Pull a task off every wait queue it is on */
+void waitq_cancel(task_t *task) {
+    uint32_t i;
+
+    if (task->wait_node.queue) {
+        waitq_del(task->wait_node.queue, &task->wait_node);
+    }
+
+    for (i = 0; i < task->wait_multi_count; i++) {
+        if (task->wait_multi[i].queue) {
+            waitq_del(task->wait_multi[i].queue, &task->wait_multi[i]);
+        }
+    }
+
+    task->wait_pending = FALSE;
+}
+
+/* Get the task that would be woken next */
+task_t *waitq_peek(wait_queue_t *wq) {
+    wait_node_t *node = waitq_first(wq);
+
+    return node ? node->task : NULL;
+}
+
+/* Remove and return the task that should be woken next */
+task_t *waitq_dequeue(wait_queue_t *wq) {
+    wait_node_t *node = waitq_first(wq);
+
+    if (!node) {
+        return NULL;
+    }
+
+    waitq_del(wq, node);
+    node->task->wait_pending = FALSE;
+
+    return node->task;
+}
+
+/* Block the current task on a wait queue
+ *
+ * Must be called with preemption disabled; returns with it enabled. The
+ * result is whatever the waker stored in wait_result, or ERROR on timeout.
+ */
+int32_t waitq_block(wait_queue_t *wq, void *obj, uint32_t timeout_ms) {
+    task_t *current = task_get_current();
+
+    if (!current) {
+        scheduler_enable_preemption();
+        return ERROR;
+    }
+
+    waitq_enqueue(wq, current);
+
+    return waitq_sleep(wq, obj, timeout_ms);
+}
+
+/* Sleep until woken, once the current task is already on the wait queue
+ *
+ * Lets callers act on the queued state (e.g. priority inheritance) before
+ * giving up the CPU. Same preemption contract as waitq_block().
+ */
+int32_t waitq_sleep(wait_queue_t *wq, void *obj, uint32_t timeout_ms) {
+    task_t *current = task_get_current();
+
+    current->wait_obj = obj;
+    waitq_park(timeout_ms);
+
+    /* Still pending means the timeout fired before anyone woke us */
+    if (current->wait_pending) {
+        waitq_remove(wq, current);
+        current->wait_result = ERROR;
+    }
+    current->wait_obj = NULL;
+    scheduler_enable_preemption();
+
+    return current->wait_result;
+}
+
+/* Give up the CPU until claimed by a waker or timed out
+ *
+ * The current task must already be queued. Called and returns with
+ * preemption disabled; the caller unlinks any nodes still queued.
+ */
+void waitq_park(uint32_t timeout_ms) {
+    task_t *current = task_get_current();
+
+    current->wait_result = ERROR;
+    current->wait_fired = NULL;
+
+    if (timeout_ms > 0) {
+        current->wake_time = scheduler_get_tick_count() +
+                             (timeout_ms * TIMER_FREQ_HZ) / 1000;
+    } else {
+        current->wake_time = 0;
+    }
+
+    scheduler_block_task(current);
+    scheduler_enable_preemption();
+    schedule();
+    scheduler_disable_preemption();
+}
+
+/* Wake the next waiter with a successful result */
+task_t *waitq_wake_one(wait_queue_t *wq) {
+    wait_node_t *node = waitq_first(wq);
+
+    if (!node) {
+        return NULL;
+    }
+
+    waitq_claim(wq, node, SUCCESS);
+
+    return node->task;
+}
+
+/* Wake every waiter, handing each the given result */
+uint32_t waitq_wake_all(wait_queue_t *wq, int32_t result) {
+    wait_node_t *node;
+    uint32_t woken = 0;
+
+    while ((node = waitq_first(wq)) != NULL) {
+        waitq_claim(wq, node, result);
+        woken++;
+    }
+
+    return woken;
+}
+
+/* Wake, in queue order, every waiter the filter accepts (single pass) */
+uint32_t waitq_wake_if(wait_queue_t *wq, waitq_match_t match, void *arg) {
+    wait_node_t *node;
+    wait_node_t *next;
+    wait_node_t *last;
+    uint32_t pending;
+    uint32_t lvl;
+    uint32_t woken = 0;
+    bool_t done;
+
+    pending = wq->bitmap;
+    while (pending) {
+        lvl = bit_highest(pending);
+        pending &= ~(1U << lvl);
+
+        /* The ring shrinks as we go, so stop at the node that was last */
+        node = wq->level[lvl];
+        last = node->prev;
+        do {
+            next = node->next;
+            done = (node == last);
+            if (!node->task->wait_pending) {
+                waitq_del(wq, node);
+            } else if (match(node, arg)) {
+                waitq_claim(wq, node, SUCCESS);
+                woken++;
+            }
+            node = next;
+        } while (!done);
+    }
+
+    return woken;
+}
@@ -0,0 +1,266 @@
+#include "../include/workq.h"
+#include "../include/waitq.h"
+#include "../include/scheduler.h"
+#include "../include/memory.h"
+#include "../include/tsc.h"
+#include "../include/io.h"
+#include "../include/config.h"
+
+/* All work queues, for statistics */
+static workq_t *workq_head = NULL;
+static spinlock_t workq_list_lock;
+
+/* Tasks in work_wait(), each waiting on its wait_obj (zeroed: an empty
+ * FIFO queue) */
+static wait_queue_t work_waiters;
+
+/* Match the waiters of a finished job */
+static bool_t work_match(wait_node_t *node, void *arg) {
+    return node->task->wait_obj == arg;
+}
+
+/* Take the oldest job, recording how long it waited */
+static work_t *workq_take(workq_t *wq) {
+    work_t *work;
+    uint32_t now = tsc_read32();
+    uint32_t latency;
+    irq_flags_t flags;
+    
+    flags = spin_lock_irqsave(&wq->lock);
+    
+    work = wq->head;
+    if (work) {
+        wq->head = work->next;
+        if (!wq->head) {
+            wq->tail = NULL;
+        }
+        work->next = NULL;
+        work->state = WORK_RUNNING;
+        wq->stats.queued--;
+        
+        latency = tsc_to_us(now - work->submit_tsc);
+        if (latency > wq->stats.latency_max) {
+            wq->stats.latency_max = latency;
+        }
+        wq->stats.latency_total += latency;
+    }
+    
+    spin_unlock_irqrestore(&wq->lock, flags);
+    
+    return work;
+}
+
+/* Worker task: run jobs in submission order */
+static void workq_worker(void *arg) {
+    workq_t *wq = (workq_t *)arg;
+    work_t *work;
+    uint32_t start;
+    uint32_t exec;
+    irq_flags_t flags;
+    
+    while (1) {
+        if (sem_wait(&wq->pending, 0) != SUCCESS) {
+            continue;
+        }
+        
+        work = workq_take(wq);
+        if (!work) {
+            continue;
+        }
+        
+        start = tsc_read32();
+        work->func(work->arg);
+        exec = tsc_to_us(tsc_read32() - start);
+        
+        flags = spin_lock_irqsave(&wq->lock);
+        if (exec > wq->stats.exec_max) {
+            wq->stats.exec_max = exec;
+        }
+        wq->stats.exec_total += exec;
+        wq->stats.completed++;
+        spin_unlock_irqrestore(&wq->lock, flags);
+        
+        /* Mark it done and wake its waiters in one step under the kernel
+         * lock; the owner may resubmit or free it as soon as we let go */
+        scheduler_disable_preemption();
+        work->state = WORK_DONE;
+        if (!waitq_empty(&work_waiters)) {
+            waitq_wake_if(&work_waiters, work_match, work);
+        }
+        scheduler_enable_preemption();
+    }
+}
+
+/* Link a job at the tail (queue locked); FALSE if it is still in flight */
+static bool_t workq_link(workq_t *wq, work_t *work, uint32_t now) {
+    if (work->state == WORK_QUEUED || work->state == WORK_RUNNING) {
+        return FALSE;
+    }
+    
+    work->state = WORK_QUEUED;
+    work->submit_tsc = now;
+    work->next = NULL;
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+    wq->stats.queued++;
+    wq->stats.submitted++;
+    
+    return TRUE;
+}
+
+/* Create a work queue and start its workers */
+int32_t workq_create(workq_t **wq, const char *name, uint32_t workers,
+                     uint8_t priority) {
+    workq_t *q;
+    task_t *worker;
+    uint32_t i;
+    irq_flags_t flags;
+    
+    if (!wq || !name || workers == 0 || workers > WORKQ_MAX_WORKERS ||
+        priority > MAX_PRIORITY) {
+        return ERROR;
+    }
+    
+    q = (workq_t *)kmalloc(sizeof(workq_t));
+    if (!q) {
+        return ERROR;
+    }
+    
+    memset(q, 0, sizeof(workq_t));
+    q->name = name;
+    spin_init(&q->lock);
+    sem_init(&q->pending, 0, 0xFFFFFFFF);
+    
+    for (i = 0; i < workers; i++) {
+        if (task_create(&worker, name, workq_worker, q, priority, 0) != SUCCESS) {
+            break;
+        }
+        q->workers++;
+    }
+    
+    /* Workers already started cannot be taken back; keep what we got */
+    if (q->workers == 0) {
+        sem_destroy(&q->pending);
+        kfree(q);
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&workq_list_lock);
+    q->next = workq_head;
+    workq_head = q;
+    spin_unlock_irqrestore(&workq_list_lock, flags);
+    
+    *wq = q;
+    
+    return SUCCESS;
+}
+
+/* Prepare a job for submission */
+int32_t work_init(work_t *work, work_func_t func, void *arg) {
+    if (!work || !func) {
+        return ERROR;
+    }
+    
+    work->func = func;
+    work->arg = arg;
+    work->state = WORK_IDLE;
+    work->submit_tsc = 0;
+    work->next = NULL;
+    
+    return SUCCESS;
+}
+
+/* Queue a job; ERROR if it is already queued or running */
+int32_t workq_submit(workq_t *wq, work_t *work) {
+    bool_t linked;
+    irq_flags_t flags;
+    
+    if (!wq || !work) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&wq->lock);
+    linked = workq_link(wq, work, tsc_read32());
+    spin_unlock_irqrestore(&wq->lock, flags);
+    
+    if (!linked) {
+        return ERROR;
+    }
+    
+    sem_post(&wq->pending);
+    
+    return SUCCESS;
+}
+
+/* Queue several jobs under one lock acquisition
+ *
+ * Jobs still in flight are skipped. Returns the number queued.
+ */
+int32_t workq_submit_batch(workq_t *wq, work_t **works, uint32_t count) {
+    uint32_t now = tsc_read32();
+    uint32_t queued = 0;
+    uint32_t i;
+    irq_flags_t flags;
+    
+    if (!wq || !works) {
+        return ERROR;
+    }
+    
+    flags = spin_lock_irqsave(&wq->lock);
+    for (i = 0; i < count; i++) {
+        if (works[i] && workq_link(wq, works[i], now)) {
+            queued++;
+        }
+    }
+    wq->stats.batches++;
+    spin_unlock_irqrestore(&wq->lock, flags);
+    
+    for (i = 0; i < queued; i++) {
+        sem_post(&wq->pending);
+    }
+    
+    return (int32_t)queued;
+}
+
+/* Wait for a job to finish (0 = forever) */
+int32_t work_wait(work_t *work, uint32_t timeout_ms) {
+    if (!work) {
+        return ERROR;
+    }
+    
+    scheduler_disable_preemption();
+    
+    if (work->state == WORK_IDLE || work->state == WORK_DONE) {
+        scheduler_enable_preemption();
+        return (work->state == WORK_DONE) ? SUCCESS : ERROR;
+    }
+    
+    return waitq_block(&work_waiters, work, timeout_ms);
+}
+
+/* Check whether a job has finished */
+bool_t work_is_done(work_t *work) {
+    return work && work->state == WORK_DONE;
+}
+
+/* Copy a queue's counters */
+void workq_get_stats(workq_t *wq, workq_stats_t *stats) {
+    irq_flags_t flags;
+    
+    if (!wq || !stats) {
+        return;
+    }
+    
+    flags = spin_lock_irqsave(&wq->lock);
+    *stats = wq->stats;
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/* Get the first work queue (follow next for the rest) */
+workq_t *workq_get_list(void) {
+    return workq_head;
+}
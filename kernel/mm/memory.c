@@ -1,4 +1,5 @@
 #include "../include/memory.h"
+#include "../include/spinlock.h"
 
 /* Simple block-based memory allocator */
 
@@ -12,6 +13,7 @@ static uint8_t *heap_start = NULL;
 static size_t heap_size = 0;
 static mem_block_t *free_list = NULL;
 static size_t total_allocated = 0;
+static spinlock_t heap_lock;
 
 #define BLOCK_HEADER_SIZE sizeof(mem_block_t)
 #define ALIGN_SIZE 8
@@ -85,6 +87,7 @@ static void merge_free_blocks(void) {
 /* Allocate memory */
 void *kmalloc(size_t size) {
     mem_block_t *block;
+    irq_flags_t flags;
     
     if (size == 0 || !heap_start) {
         return NULL;
@@ -92,8 +95,11 @@ void *kmalloc(size_t size) {
     
     size = ALIGN(size);
     
+    flags = spin_lock_irqsave(&heap_lock);
+    
     block = find_free_block(size);
     if (!block) {
+        spin_unlock_irqrestore(&heap_lock, flags);
         return NULL;
     }
     
@@ -101,18 +107,24 @@ void *kmalloc(size_t size) {
     block->is_free = FALSE;
     total_allocated += size;
     
+    spin_unlock_irqrestore(&heap_lock, flags);
+    
     return (void *)((uint8_t *)block + BLOCK_HEADER_SIZE);
 }
 
 /* Free memory */
 void kfree(void *ptr) {
     mem_block_t *block;
+    irq_flags_t flags;
     
     if (!ptr || !heap_start) {
         return;
     }
     
     block = (mem_block_t *)((uint8_t *)ptr - BLOCK_HEADER_SIZE);
+    
+    flags = spin_lock_irqsave(&heap_lock);
+    
     block->is_free = TRUE;
     
     if (total_allocated >= block->size) {
@@ -122,6 +134,8 @@ void kfree(void *ptr) {
     }
     
     merge_free_blocks();
+    
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
 
 /* Reallocate memory */
@@ -3,6 +3,15 @@
 #include "../include/memory.h"
 #include "../include/task.h"
 #include "../include/scheduler.h"
+#include "../include/semaphore.h"
+#include "../include/defer.h"
+#include "../include/tsc.h"
+#include "../include/irq.h"
+#include "../include/smp.h"
+#include "../include/reserve.h"
+#include "../include/cyclic.h"
+#include "../include/actor.h"
+#include "../include/workq.h"
 #include "../include/config.h"
 
 #define MAX_COMMANDS 32
@@ -74,6 +83,285 @@ static int32_t cmd_ps(int argc, char **argv) {
     return SUCCESS;
 }
 
+static int32_t cmd_semstat(int argc, char **argv) {
+    sem_stats_t stats;
+    
+    sem_get_stats(&stats);
+    
+    printf("Semaphore Statistics:\n");
+    printf("  Wait fast path: %u\n", stats.fast_waits);
+    printf("  Wait slow path: %u\n", stats.slow_waits);
+    printf("  Post fast path: %u\n", stats.fast_posts);
+    printf("  Post slow path: %u\n", stats.slow_posts);
+    
+    return SUCCESS;
+}
+
+static int32_t cmd_softirq(int argc, char **argv) {
+    defer_stats_t stats;
+    isr_defer_t *item;
+    
+    defer_get_stats(&stats);
+    
+    printf("Deferred Interrupt Work (TSC %u MHz):\n", tsc_get_mhz());
+    printf("  Items run:     %u (%u in worker)\n", stats.runs, stats.worker_runs);
+    printf("  Longest run:   %u us\n", tsc_to_us(stats.max_cycles));
+    
+    for (item = defer_get_named(); item; item = item->next_named) {
+        printf("  %s: %u runs, last %u us, max %u us\n", item->name, item->runs,
+               tsc_to_us(item->last_cycles), tsc_to_us(item->max_cycles));
+    }
+    
+    printf("  (unnamed): %u runs, max %u us\n", stats.anon_runs,
+           tsc_to_us(stats.anon_max_cycles));
+    
+    return SUCCESS;
+}
+
+static int32_t cmd_irqtrace(int argc, char **argv) {
+#if IRQ_TRACE_ENABLED
+    irq_trace_entry_t entries[IRQ_TRACE_SITES];
+    uint32_t count;
+    uint32_t i;
+    
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        irq_trace_reset();
+        printf("Interrupts-off trace cleared\n");
+        return SUCCESS;
+    }
+    
+    count = irq_trace_get(entries, IRQ_TRACE_SITES);
+    
+    printf("Longest Interrupts-Off Windows (TSC %u MHz):\n", tsc_get_mhz());
+    for (i = 0; i < count; i++) {
+        printf("  %u. %s: max %u us (%u cycles), %u windows\n", i + 1,
+               entries[i].site, tsc_to_us(entries[i].max_cycles),
+               entries[i].max_cycles, entries[i].count);
+    }
+    if (count == 0) {
+        printf("  (none recorded)\n");
+    }
+#else
+    printf("Interrupts-off tracing is disabled (IRQ_TRACE_ENABLED)\n");
+#endif
+    
+    return SUCCESS;
+}
+
+static int32_t cmd_cpus(int argc, char **argv) {
+    cpu_t *cpu;
+    task_t *current;
+    uint32_t i;
+    
+    printf("CPUs (%u):\n", smp_cpu_count());
+    for (i = 0; i < smp_cpu_count(); i++) {
+        cpu = cpu_get(i);
+        if (!cpu->online) {
+            continue;
+        }
+        
+        current = cpu->current;
+        printf("  CPU %u (APIC %u): running %s, %u ready\n", cpu->id, cpu->apic_id,
+               current ? current->name : "-", cpu->nr_ready);
+        printf("    %u ticks, %u switches, %u steals, %u IPIs\n",
+               cpu->ticks, cpu->switches, cpu->steals, cpu->ipis);
+        printf("    EDF utilization: %u/%u\n", cpu->edf_util, EDF_UTIL_SCALE);
+    }
+    
+    return SUCCESS;
+}
+
+static int32_t cmd_periodic(int argc, char **argv) {
+    periodic_info_t info;
+    periodic_stats_t *stats = &info.stats;
+    uint32_t i;
+    
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        task_reset_periodic_stats(NULL);
+        printf("Periodic task statistics cleared\n");
+        return SUCCESS;
+    }
+    
+    printf("Periodic Tasks (times in us):\n");
+    for (i = 0; task_get_periodic_info(i, &info) == SUCCESS; i++) {
+        printf("  %s: period %u ticks, %u jobs, %u overruns",
+               info.name, info.period, stats->jobs, stats->overruns);
+        if (info.sched_class == SCHED_EDF) {
+            printf(", %u deadline misses", info.deadline_misses);
+        }
+        printf("\n");
+        
+        if (stats->jobs > 0) {
+            printf("    jitter min %u avg %u max %u\n", stats->jitter_min,
+                   stats->jitter_avg, stats->jitter_max);
+        }
+        if (stats->completed > 0) {
+            printf("    exec   min %u avg %u max %u\n", stats->exec_min,
+                   stats->exec_avg, stats->exec_max);
+        }
+    }
+    if (i == 0) {
+        printf("  (none)\n");
+    }
+    
+    return SUCCESS;
+}
+
+static int32_t cmd_fair(int argc, char **argv) {
+    task_t *task;
+    uint32_t total_ticks = 0;
+    uint32_t total_weight = 0;
+    
+    for (task = task_get_fair(); task; task = task->next_fair) {
+        total_ticks += task->fair_ticks;
+        total_weight += task->fair_weight;
+    }
+    
+    printf("Fair-Share Tasks (level %u):\n", FAIR_PRIORITY);
+    for (task = task_get_fair(); task; task = task->next_fair) {
+        printf("  %s: weight %u (%u%%), ran %u ticks (%u%%), vruntime %u\n",
+               task->name, task->fair_weight,
+               (task->fair_weight * 100) / total_weight, task->fair_ticks,
+               total_ticks ? (task->fair_ticks * 100) / total_ticks : 0,
+               task->vruntime);
+    }
+    if (!task_get_fair()) {
+        printf("  (none)\n");
+    }
+    
+    return SUCCESS;
+}
+
+static int32_t cmd_reserves(int argc, char **argv) {
+    reserve_t *res;
+    task_t *task;
+    
+    printf("CPU Reservations (ticks):\n");
+    for (res = reserve_get_list(); res; res = res->next) {
+        printf("  %s: budget %u/%u, %u left%s\n", res->name, res->budget,
+               res->period, res->remaining, res->throttled ? ", throttled" : "");
+        printf("    %u consumed, %u throttles, %u replenishments\n",
+               res->consumed, res->throttles, res->replenishments);
+        printf("    members:");
+        for (task = res->members; task; task = task->next_reserved) {
+            printf(" %s", task->name);
+        }
+        printf("\n");
+    }
+    if (!reserve_get_list()) {
+        printf("  (none)\n");
+    }
+    
+    return SUCCESS;
+}
+
+/* Check whether a cyclic task appears in a slot before (frame, slot) */
+static bool_t cyclic_listed_before(const cyclic_table_t *table, uint32_t frame,
+                                   uint32_t slot, cyclic_task_t *ct) {
+    uint32_t i;
+    uint32_t j;
+    
+    for (i = 0; i <= frame; i++) {
+        for (j = 0; table->frames[i].slots[j]; j++) {
+            if (i == frame && j == slot) {
+                return FALSE;
+            }
+            if (table->frames[i].slots[j] == ct) {
+                return TRUE;
+            }
+        }
+    }
+    
+    return FALSE;
+}
+
+static int32_t cmd_cyclic(int argc, char **argv) {
+    const cyclic_table_t *table = cyclic_get_table();
+    const cyclic_frame_t *frame;
+    cyclic_task_t *ct;
+    cyclic_stats_t stats;
+    uint32_t i;
+    uint32_t j;
+    
+    if (!table) {
+        printf("Cyclic executive not started\n");
+        return SUCCESS;
+    }
+    
+    cyclic_get_stats(&stats);
+    
+    printf("Cyclic Executive (%s, TSC %u MHz):\n",
+           cyclic_is_running() ? "running" : "stopped", tsc_get_mhz());
+    printf("  %u minor frames of %u ticks per major frame\n",
+           table->frame_count, table->minor_ticks);
+    printf("  %u minor, %u major frames, %u overruns, %u slots skipped\n",
+           stats.minor_frames, stats.major_frames, stats.overruns, stats.skipped);
+    
+    for (i = 0; i < table->frame_count; i++) {
+        frame = &table->frames[i];
+        printf("  frame %u:", i);
+        for (j = 0; frame->slots[j]; j++) {
+            printf(" %s", frame->slots[j]->name);
+        }
+        printf("\n");
+    }
+    
+    /* Each task once, where it first appears */
+    for (i = 0; i < table->frame_count; i++) {
+        frame = &table->frames[i];
+        for (j = 0; frame->slots[j]; j++) {
+            ct = frame->slots[j];
+            if (!cyclic_listed_before(table, i, j, ct)) {
+                printf("  %s: %u runs, %u overruns, latency max %u us, exec max %u us\n",
+                       ct->name, ct->runs, ct->overruns,
+                       tsc_to_us(ct->max_latency), tsc_to_us(ct->max_exec));
+            }
+        }
+    }
+    
+    return SUCCESS;
+}
+
+static int32_t cmd_actors(int argc, char **argv) {
+    actor_stats_t stats;
+    
+    actor_get_stats(&stats);
+    
+    printf("Actor Runtime (%u workers):\n", ACTOR_WORKERS);
+    printf("  Live actors:   %u\n", stats.actors);
+    printf("  Delivered:     %u messages in %u runs\n", stats.messages, stats.batches);
+    printf("  Average batch: %u (max %u, limit %u)\n",
+           stats.batches ? stats.messages / stats.batches : 0,
+           stats.max_batch, ACTOR_BATCH);
+    
+    return SUCCESS;
+}
+
+static int32_t cmd_workq(int argc, char **argv) {
+    workq_t *wq = workq_get_list();
+    workq_stats_t stats;
+    
+    if (!wq) {
+        printf("No work queues\n");
+        return SUCCESS;
+    }
+    
+    printf("Work Queues:\n");
+    for (; wq; wq = wq->next) {
+        workq_get_stats(wq, &stats);
+        printf("  %s: %u workers, %u queued, %u/%u done, %u batches\n",
+               wq->name, wq->workers, stats.queued, stats.completed,
+               stats.submitted, stats.batches);
+        printf("    latency avg %u us max %u us, exec avg %u us max %u us\n",
+               stats.completed ? stats.latency_total / stats.completed : 0,
+               stats.latency_max,
+               stats.completed ? stats.exec_total / stats.completed : 0,
+               stats.exec_max);
+    }
+    
+    return SUCCESS;
+}
+
 static int32_t cmd_echo(int argc, char **argv) {
     int i;
     
@@ -108,10 +396,12 @@ static void test_task_func(void *arg) {
     }
     
     printf("Task %d: completed\n", id);
+    task_exit(id);
 }
 
 static int32_t cmd_test_tasks(int argc, char **argv) {
     task_t *task1, *task2;
+    int32_t code1, code2;
     
     printf("Creating test tasks...\n");
     
@@ -129,6 +419,18 @@ static int32_t cmd_test_tasks(int argc, char **argv) {
     
     printf("Test tasks created successfully\n");
     
+    /* Wait for both, then reclaim them */
+    if (task_join(task1, &code1, 0) != SUCCESS ||
+        task_join(task2, &code2, 0) != SUCCESS) {
+        printf("Failed to join test tasks\n");
+        return ERROR;
+    }
+    
+    printf("Test tasks exited with codes %d and %d\n", code1, code2);
+    
+    task_destroy(task1);
+    task_destroy(task2);
+    
     return SUCCESS;
 }
 
@@ -141,6 +443,16 @@ void shell_init(void) {
     shell_register_command("clear", "Clear the screen", cmd_clear);
     shell_register_command("meminfo", "Display memory information", cmd_meminfo);
     shell_register_command("ps", "Display process information", cmd_ps);
+    shell_register_command("semstat", "Display semaphore path statistics", cmd_semstat);
+    shell_register_command("softirq", "Display deferred interrupt work timing", cmd_softirq);
+    shell_register_command("irqtrace", "Display worst interrupts-off windows", cmd_irqtrace);
+    shell_register_command("cpus", "Display per-CPU scheduler state", cmd_cpus);
+    shell_register_command("periodic", "Display periodic task jitter and overruns", cmd_periodic);
+    shell_register_command("fair", "Display fair-share weights and CPU split", cmd_fair);
+    shell_register_command("reserves", "Display CPU reservation budgets", cmd_reserves);
+    shell_register_command("cyclic", "Display the cyclic executive schedule", cmd_cyclic);
+    shell_register_command("actors", "Display actor runtime statistics", cmd_actors);
+    shell_register_command("workq", "Display work queue statistics", cmd_workq);
     shell_register_command("echo", "Echo arguments to output", cmd_echo);
     shell_register_command("uname", "Display system information", cmd_uname);
     shell_register_command("test", "Run task test", cmd_test_tasks);